@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+/*
+In debug builds (without NDEBUG) every call to the global operator new is counted, so that tests like bench can show whether 
+the search allocates. Release builds don't replace operator new and this always returns 0.
+*/
+uint64_t AllocationCount();
@@ -18,27 +18,47 @@ void BitBoard::SetSquare(unsigned int square, unsigned int piece)
 	ClearSquare(square);
 
 	if (piece < N_PIECES)	//it is possible we might set a square to be empty using this function rather than using the ClearSquare function below. 
+	{
 		m_Bitboard[piece] |= SquareBB[square];
+		m_Occupancy[ColourOfPiece(piece)] |= SquareBB[square];
+		m_AllPieces |= SquareBB[square];
+		m_Mailbox[square] = piece;
+		m_MaterialKey += MaterialKeyDelta(piece);
+	}
 }
 
 void BitBoard::ClearSquare(unsigned int square)
 {
 	assert(square < N_SQUARES);
 
-	for (int i = 0; i < N_PIECES; i++)
-	{
-		m_Bitboard[i] &= ~SquareBB[square];
-	}
+	unsigned int piece = m_Mailbox[square];
+
+	if (piece == N_PIECES)
+		return;
+
+	m_Bitboard[piece] &= ~SquareBB[square];
+	m_Occupancy[ColourOfPiece(piece)] &= ~SquareBB[square];
+	m_AllPieces &= ~SquareBB[square];
+	m_Mailbox[square] = N_PIECES;
+	m_MaterialKey -= MaterialKeyDelta(piece);
 }
 
 void BitBoard::ResetBoard()
 {
-	previousBoards.clear();
-
 	for (int i = 0; i < N_PIECES; i++)
 	{
 		m_Bitboard[i] = EMPTY;
 	}
+
+	m_Occupancy[WHITE] = EMPTY;
+	m_Occupancy[BLACK] = EMPTY;
+	m_AllPieces = EMPTY;
+	m_MaterialKey = 0;
+
+	for (int i = 0; i < N_SQUARES; i++)
+	{
+		m_Mailbox[i] = N_PIECES;
+	}
 }
 
 bool BitBoard::InitialiseBoardFromFen(std::vector<std::string> fen)
@@ -84,34 +104,11 @@ bool BitBoard::InitialiseBoardFromFen(std::vector<std::string> fen)
 	return true;
 }
 
-void BitBoard::SaveBoard()
-{
-	previousBoards.push_back(static_cast<BitBoardData>(*this));
-}
-
-void BitBoard::RestorePreviousBoard()
-{
-	assert(previousBoards.size() != 0);
-
-	for (int i = 0; i < N_PIECES; i++)
-	{
-		m_Bitboard[i] = previousBoards.back().GetPieceBB(i);
-	}
-
-	previousBoards.pop_back();
-}
-
-BitBoardData BitBoard::GetPreviousBoard()
-{
-	assert(previousBoards.size() != 0);
-	return previousBoards.back();
-}
-
 bool BitBoard::IsEmpty(unsigned int square) const
 {
 	assert(square < N_SQUARES);
 
-	return ((SquareBB[square] & GetEmptySquares()) != 0);
+	return m_Mailbox[square] == N_PIECES;
 }
 
 bool BitBoard::IsOccupied(unsigned int square) const
@@ -125,12 +122,12 @@ bool BitBoard::IsOccupied(unsigned int square, bool colour) const
 {
 	assert(square < N_SQUARES);
 
-	return ((SquareBB[square] & GetPiecesColour(colour)) != 0);
+	return ((SquareBB[square] & m_Occupancy[colour]) != 0);
 }
 
 uint64_t BitBoard::GetAllPieces() const
 {
-	return GetWhitePieces() | GetBlackPieces();
+	return m_AllPieces;
 }
 
 uint64_t BitBoard::GetEmptySquares() const
@@ -140,20 +137,17 @@ uint64_t BitBoard::GetEmptySquares() const
 
 uint64_t BitBoard::GetWhitePieces() const
 {
-	return m_Bitboard[WHITE_PAWN] | m_Bitboard[WHITE_KNIGHT] | m_Bitboard[WHITE_BISHOP] | m_Bitboard[WHITE_ROOK] | m_Bitboard[WHITE_QUEEN] | m_Bitboard[WHITE_KING];
+	return m_Occupancy[WHITE];
 }
 
 uint64_t BitBoard::GetBlackPieces() const
 {
-	return m_Bitboard[BLACK_PAWN] | m_Bitboard[BLACK_KNIGHT] | m_Bitboard[BLACK_BISHOP] | m_Bitboard[BLACK_ROOK] | m_Bitboard[BLACK_QUEEN] | m_Bitboard[BLACK_KING];
+	return m_Occupancy[BLACK];
 }
 
 uint64_t BitBoard::GetPiecesColour(bool colour) const
 {
-	if (colour == WHITE)
-		return GetWhitePieces();
-	else
-		return GetBlackPieces();
+	return m_Occupancy[colour];
 }
 
 uint64_t BitBoard::GetPieceBB(unsigned int pieceType, bool colour) const
@@ -169,9 +163,12 @@ unsigned int BitBoard::GetKing(bool colour) const
 	return LSB(GetPieceBB(KING, colour));
 }
 
-BitBoardData::BitBoardData() : m_Bitboard {0}
+BitBoardData::BitBoardData() : m_Bitboard {0}, m_Occupancy {0}, m_AllPieces(0), m_MaterialKey(0)
 {
-
+	for (int i = 0; i < N_SQUARES; i++)
+	{
+		m_Mailbox[i] = N_PIECES;
+	}
 }
 
 uint64_t BitBoardData::GetPieceBB(unsigned int piece) const
@@ -185,11 +182,5 @@ unsigned int BitBoardData::GetSquare(unsigned int square) const
 {
 	assert(square < N_SQUARES);
 
-	for (int i = 0; i < N_PIECES; i++)
-	{
-		if ((m_Bitboard[i] & SquareBB[square]) != 0)
-			return i;
-	}
-
-	return N_PIECES;
+	return m_Mailbox[square];
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "BitBoardDefine.h"
+#include "Material.h"
 #include <vector>
 
 struct BitBoardData
@@ -8,12 +9,17 @@ struct BitBoardData
 
 	BitBoardData();
 
-	//we need these functions because Zobrist increment will access the previous BitBoardData from previousBoards and it then needs to extract this information
 	uint64_t GetPieceBB(unsigned int piece) const;
 	unsigned int GetSquare(unsigned int square) const;	//returns N_PIECES = 12 if empty
 
 private:
 	uint64_t m_Bitboard[N_PIECES];
+
+	//redundant with m_Bitboard, but kept up to date by SetSquare and ClearSquare so the lookups don't have to loop over every piece
+	uint64_t m_Occupancy[N_PLAYERS];					//all the pieces of each colour
+	uint64_t m_AllPieces;
+	uint8_t m_Mailbox[N_SQUARES];						//the piece on each square, or N_PIECES if it's empty
+	uint64_t m_MaterialKey;								//see Material.h
 };
 
 class BitBoard : public BitBoardData
@@ -33,6 +39,7 @@ public:
 	uint64_t GetPiecesColour(bool colour) const;
 	uint64_t GetPieceBB(unsigned int pieceType, bool colour) const;
 	unsigned int GetKing(bool colour) const;
+	uint64_t GetMaterialKey() const { return m_MaterialKey; }
 
 	void SetSquare(unsigned int square, unsigned int piece);
 	void ClearSquare(unsigned int square);
@@ -42,13 +49,5 @@ public:
 protected:
 	void ResetBoard();
 	bool InitialiseBoardFromFen(std::vector<std::string> fen);
-
-	void SaveBoard();
-	void RestorePreviousBoard();
-
-	BitBoardData GetPreviousBoard();
-
-private:
-	std::vector<BitBoardData> previousBoards;
 };
 
@@ -1,4 +1,5 @@
 #include "BitBoardDefine.h"
+#include <vector>
 
 uint64_t EMPTY;
 uint64_t UNIVERCE;
@@ -24,6 +25,34 @@ uint64_t BlackPawnAttacks[N_SQUARES];
 uint64_t allBitsBelow[N_SQUARES];
 uint64_t allBitsAbove[N_SQUARES];
 
+struct SliderTable
+{
+	uint64_t mask;					//the squares that can block the piece, not counting the edge of the board
+	uint64_t magic;
+	unsigned int shift;
+	uint64_t* attacks;				//this squares slice of the attack table
+
+	size_t Index(uint64_t occupied) const
+	{
+#if defined(USE_PEXT)
+		return _pext_u64(occupied, mask);
+#else
+		return ((occupied & mask) * magic) >> shift;
+#endif
+	}
+};
+
+SliderTable BishopTable[N_SQUARES];
+SliderTable RookTable[N_SQUARES];
+uint64_t BishopAttackTable[0x1480];	//the sum over all squares of 2 ^ (bits in the mask)
+uint64_t RookAttackTable[0x19000];
+
+const int BishopDirections[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+const int RookDirections[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+void InitSliderTable(SliderTable table[N_SQUARES], uint64_t attackTable[], const int directions[4][2]);
+uint64_t SlidingAttacks(unsigned int square, uint64_t occupied, const int directions[4][2]);
+
 bool HASH_ENABLE = true;
 
 const int index64[64] = {
@@ -166,6 +195,153 @@ void BBInit()
 		BishopAttacks[i] = (DiagonalBB[GetDiagonal(i)] | AntiDiagonalBB[GetAntiDiagonal(i)]) ^ SquareBB[i];
 		QueenAttacks[i] = RookAttacks[i] | BishopAttacks[i];
  	}
+
+	InitSliderTable(BishopTable, BishopAttackTable, BishopDirections);
+	InitSliderTable(RookTable, RookAttackTable, RookDirections);
+}
+
+void InitSliderTable(SliderTable table[N_SQUARES], uint64_t attackTable[], const int directions[4][2])
+{
+	std::vector<uint64_t> occupancies(4096);
+	std::vector<uint64_t> references(4096);
+	uint64_t* next = attackTable;
+
+#if !defined(USE_PEXT)	//only the magic search needs these. They carry over from one square to the next
+	std::vector<unsigned int> used(4096, 0);	//which attempt last wrote to each index, so the table doesn't need clearing between attempts
+	unsigned int attempt = 0;
+	uint64_t seed = 0x9E3779B97F4A7C15;			//fixed so that the magics are the same every run
+
+	auto random = [&seed]()	//xorshift64*
+	{
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		return seed * 2685821657736338717ULL;
+	};
+#endif
+
+	for (unsigned int sq = 0; sq < N_SQUARES; sq++)
+	{
+		SliderTable& entry = table[sq];
+		uint64_t edges = ((RankBB[RANK_1] | RankBB[RANK_8]) & ~RankBB[GetRank(sq)]) | ((FileBB[FILE_A] | FileBB[FILE_H]) & ~FileBB[GetFile(sq)]);
+
+		entry.mask = SlidingAttacks(sq, EMPTY, directions) & ~edges;
+		entry.shift = 64 - GetBitCount(entry.mask);
+		entry.attacks = next;
+
+		//every subset of the mask, with the carry rippler trick
+		size_t size = 0;
+		uint64_t subset = 0;
+
+		do
+		{
+			occupancies[size] = subset;
+			references[size] = SlidingAttacks(sq, subset, directions);
+			size++;
+			subset = (subset - entry.mask) & entry.mask;
+		} while (subset != 0);
+
+		next += size;
+
+#if defined(USE_PEXT)
+		entry.magic = 0;
+
+		for (size_t i = 0; i < size; i++)
+			entry.attacks[entry.Index(occupancies[i])] = references[i];
+#else
+		//try sparse random numbers until one maps every subset to an index without a collision (two subsets with the same attacks may share one)
+		size_t i = 0;
+
+		while (i < size)
+		{
+			do
+			{
+				entry.magic = random() & random() & random();
+			} while (GetBitCount((entry.mask * entry.magic) >> 56) < 6);
+
+			attempt++;
+
+			for (i = 0; i < size; i++)
+			{
+				size_t index = entry.Index(occupancies[i]);
+
+				if (used[index] != attempt)
+				{
+					used[index] = attempt;
+					entry.attacks[index] = references[i];
+				}
+				else if (entry.attacks[index] != references[i])
+					break;
+			}
+		}
+#endif
+	}
+}
+
+uint64_t SlidingAttacks(unsigned int square, uint64_t occupied, const int directions[4][2])
+{
+	uint64_t attacks = EMPTY;
+
+	for (int dir = 0; dir < 4; dir++)
+	{
+		int file = GetFile(square) + directions[dir][0];
+		int rank = GetRank(square) + directions[dir][1];
+
+		while (file >= FILE_A && file <= FILE_H && rank >= RANK_1 && rank <= RANK_8)
+		{
+			unsigned int sq = GetPosition(file, rank);
+			attacks |= SquareBB[sq];
+
+			if (occupied & SquareBB[sq])
+				break;
+
+			file += directions[dir][0];
+			rank += directions[dir][1];
+		}
+	}
+
+	return attacks;
+}
+
+uint64_t GetBishopAttacks(unsigned int square, uint64_t occupied)
+{
+	assert(square < N_SQUARES);
+
+	return BishopTable[square].attacks[BishopTable[square].Index(occupied)];
+}
+
+uint64_t GetRookAttacks(unsigned int square, uint64_t occupied)
+{
+	assert(square < N_SQUARES);
+
+	return RookTable[square].attacks[RookTable[square].Index(occupied)];
+}
+
+uint64_t GetQueenAttacks(unsigned int square, uint64_t occupied)
+{
+	return GetBishopAttacks(square, occupied) | GetRookAttacks(square, occupied);
+}
+
+uint64_t AttackBB(unsigned int pieceType, unsigned int square, uint64_t occupied)
+{
+	assert(square < N_SQUARES);
+
+	switch (pieceType)
+	{
+	case KNIGHT:
+		return KnightAttacks[square];
+	case BISHOP:
+		return GetBishopAttacks(square, occupied);
+	case ROOK:
+		return GetRookAttacks(square, occupied);
+	case QUEEN:
+		return GetQueenAttacks(square, occupied);
+	case KING:
+		return KingAttacks[square];
+	default:
+		assert(0);
+		return EMPTY;
+	}
 }
 
 char PieceToChar(unsigned int piece)
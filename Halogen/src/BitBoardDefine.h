@@ -9,6 +9,10 @@
 #include <intrin.h>
 #endif
 
+#if defined(USE_PEXT) && !defined(_MSC_VER)
+#include <immintrin.h>
+#endif
+
 extern bool HASH_ENABLE;
 
 enum Squares
@@ -186,6 +190,15 @@ extern uint64_t allBitsAbove[N_SQUARES];
 int LSPpop(uint64_t &bb);
 int LSB(uint64_t bb);
 
+/*
+Sliding piece attacks for a given occupancy come from a single table lookup. The index into each squares slice of the table is 
+the relevant occupied squares either compressed with PEXT (when compiled with USE_PEXT) or hashed with a magic multiplication.
+*/
+uint64_t GetBishopAttacks(unsigned int square, uint64_t occupied);
+uint64_t GetRookAttacks(unsigned int square, uint64_t occupied);
+uint64_t GetQueenAttacks(unsigned int square, uint64_t occupied);
+uint64_t AttackBB(unsigned int pieceType, unsigned int square, uint64_t occupied);	//the squares a knight, bishop, rook, queen or king attacks. Not for pawns
+
 uint64_t inBetween(unsigned int sq1, unsigned int sq2);	//return the bb of the squares in between (exclusive) the two squares
 uint64_t inBetweenCache(unsigned int from, unsigned int to);
 bool mayMove(unsigned int from, unsigned int to, uint64_t pieces);
@@ -31,8 +31,6 @@ void BoardParamiters::NextTurn()
 
 void BoardParamiters::InitParamiters()
 {
-	PreviousParamiters.clear();
-
 	m_CurrentTurn = WHITE;
 	m_WhiteKingCastle = false;
 	m_WhiteQueenCastle = false;
@@ -49,12 +47,6 @@ void BoardParamiters::InitParamiters()
 	m_CaptureSquare = -1;
 }
 
-BoardParamiterData BoardParamiters::GetPreviousParamiters()
-{
-	assert(PreviousParamiters.size() != 0);
-	return PreviousParamiters.back();
-}
-
 bool BoardParamiters::InitialiseParamitersFromFen(std::vector<std::string> fen)
 {
 	InitParamiters();
@@ -85,30 +77,9 @@ bool BoardParamiters::InitialiseParamitersFromFen(std::vector<std::string> fen)
 	return true;
 }
 
-void BoardParamiters::SaveParamiters()
+void BoardParamiters::RestoreParamiters(const BoardParamiterData& previous)
 {
-	PreviousParamiters.push_back(static_cast<BoardParamiterData>(*this));
-}
-
-void BoardParamiters::RestorePreviousParamiters()
-{
-	assert(PreviousParamiters.size() != 0);
-
-	m_CaptureSquare = PreviousParamiters.back().GetCaptureSquare();
-	m_EnPassant = PreviousParamiters.back().GetEnPassant();
-	m_FiftyMoveCount = PreviousParamiters.back().GetFiftyMoveCount();
-	m_TurnCount = PreviousParamiters.back().GetTurnCount();
-
-	m_HasCastledWhite = PreviousParamiters.back().HasCastledWhite();
-	m_HasCastledBlack = PreviousParamiters.back().HasCastledBlack();
-
-	m_CurrentTurn = PreviousParamiters.back().GetTurn();
-	m_WhiteKingCastle = PreviousParamiters.back().CanCastleWhiteKingside();
-	m_WhiteQueenCastle = PreviousParamiters.back().CanCastleWhiteQueenside();
-	m_BlackKingCastle = PreviousParamiters.back().CanCastleBlackKingside();
-	m_BlackQueenCastle = PreviousParamiters.back().CanCastleBlackQueenside();
-
-	PreviousParamiters.pop_back();			
+	static_cast<BoardParamiterData&>(*this) = previous;
 }
 
 void BoardParamiters::UpdateCastleRights(Move move)
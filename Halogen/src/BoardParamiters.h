@@ -45,8 +45,7 @@ public:
 
 protected:
 	bool InitialiseParamitersFromFen(std::vector<std::string> fen);
-	void SaveParamiters();
-	void RestorePreviousParamiters();
+	void RestoreParamiters(const BoardParamiterData& previous);		//put back the paramiters saved before a move
 	void UpdateCastleRights(Move move);
 	void SetEnPassant(unsigned int var) { m_EnPassant = var; }
 	void WhiteCastled();
@@ -57,9 +56,5 @@ protected:
 	void Reset50Move() { m_FiftyMoveCount = 0; }
 
 	void InitParamiters();
-	BoardParamiterData GetPreviousParamiters();
-
-private:
-	std::vector<BoardParamiterData> PreviousParamiters;
 };
 
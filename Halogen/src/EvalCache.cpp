@@ -1,41 +1,55 @@
 #include "EvalCache.h"
 
-EvalCacheTable::EvalCacheTable() : table(new std::array<EvalCacheEntry, 65536>)
+constexpr uint64_t EVAL_BITS = 0xFFFF;
+constexpr size_t MIN_EVAL_CACHE_ENTRIES = 1 << 16;	//see the comment in EvalCache.h
+
+EvalCacheTable evalCache;
+
+EvalCacheTable::EvalCacheTable() : table(nullptr), mask(0)
 {
+	SetSize(1);
 }
 
 EvalCacheTable::~EvalCacheTable()
 {
-	delete table;
+	delete[] table;
 }
 
 void EvalCacheTable::AddEntry(uint64_t key, int eval)
 {
-	(*table)[key % table->size()].key = key;
-	(*table)[key % table->size()].eval = eval;
+	assert(eval >= SHRT_MIN && eval <= SHRT_MAX);
+	table[key & mask].store((key & ~EVAL_BITS) | static_cast<uint16_t>(eval), std::memory_order_relaxed);
 }
 
-bool EvalCacheTable::GetEntry(uint64_t key, int& eval)
+bool EvalCacheTable::GetEntry(uint64_t key, int& eval) const
 {
-	if ((*table)[key % table->size()].key != key)
-	{
-		misses++;
-		return false;
-	}
+	uint64_t entry = table[key & mask].load(std::memory_order_relaxed);
 
-	eval = (*table)[key % table->size()].eval;
-	hits++; 
+	if ((entry & ~EVAL_BITS) != (key & ~EVAL_BITS))
+		return false;
 
+	eval = static_cast<int16_t>(entry & EVAL_BITS);
 	return true;
 }
 
 void EvalCacheTable::Reset()
 {
-	hits = 0;
-	misses = 0;
-
-	for (size_t i = 0; i < table->size(); i++)
+	for (size_t i = 0; i <= mask; i++)
 	{
-		(*table)[i] = {};
+		table[i].store(0, std::memory_order_relaxed);
 	}
 }
+
+void EvalCacheTable::SetSize(uint64_t MB)
+{
+	size_t entries = MIN_EVAL_CACHE_ENTRIES;
+
+	while (entries * 2 * sizeof(uint64_t) <= MB * 1024 * 1024)
+		entries *= 2;
+
+	delete[] table;
+	table = new std::atomic<uint64_t>[entries];
+	mask = entries - 1;
+
+	Reset();
+}
@@ -1,30 +1,40 @@
 #pragma once
 #include <vector>
 #include <memory>		//required to compile with g++
-#include <array>
+#include <atomic>
+#include <climits>
 #include <assert.h>
 #include <iostream>
 
-struct EvalCacheEntry
-{
-	uint64_t key = 0;
-	int eval = -1;
-};
+/*
+One evaluation cache is shared by all the search threads and kept between searches, as the network evaluation of a position never goes stale.
 
+Each entry is a single 64 bit word: the high 48 bits of the key with the eval in the low 16 bits. The table index comes from the low
+bits of the key and the table always has at least 2^16 entries, so together the index and the stored bits verify the whole key.
+A word is read and written in one atomic operation so the threads need no locking and a lookup can never see half of another write.
+*/
 class EvalCacheTable
 {
 public:
 	EvalCacheTable();
 	~EvalCacheTable();
 
-	void AddEntry(uint64_t key, int eval);
-	bool GetEntry(uint64_t key, int& eval);
+	void AddEntry(uint64_t key, int eval);			//eval must fit in 16 bits
+	bool GetEntry(uint64_t key, int& eval) const;
 
 	void Reset();
+	void SetSize(uint64_t MB);						//rounds down to a power of two number of entries and clears the table
+	uint64_t GetSizeMB() const { return (mask + 1) * sizeof(uint64_t) / (1024 * 1024); }
+
+private:
+	std::atomic<uint64_t>* table;
+	size_t mask;									//size - 1
+};
 
+struct EvalCacheStats								//kept per thread, so the threads don't fight over the counters
+{
 	uint64_t hits = 0;
 	uint64_t misses = 0;
-
-private:
-	std::array<EvalCacheEntry, 65536>* table;
 };
+
+extern EvalCacheTable evalCache;
@@ -8,10 +8,9 @@
 //needed for SEE
 extern int pieceValueVector[N_STAGES][N_PIECE_TYPES];
 
-bool DeadPosition(const Position& position);
 bool IsBlockade(const Position& position);
 
-int EvaluatePositionNet(Position& position, EvalCacheTable& evalTable);
+int EvaluatePositionNet(Position& position, EvalCacheStats& stats);	//looks in the shared evalCache before running the network
 
 int PieceValues(unsigned int Piece, GameStages GameStage = MIDGAME);
 
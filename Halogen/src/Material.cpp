@@ -0,0 +1,90 @@
+#include "Material.h"
+
+constexpr uint64_t PIECE_COUNT_BITS = 0x3F;
+constexpr uint64_t DEAD_POSITION_BIT = 1 << 6;
+constexpr uint64_t PAWN_ENDGAME_BIT = 1 << 7;
+
+MaterialTable materialTable;
+
+MaterialInfo CalculateMaterialInfo(uint64_t materialKey);
+uint64_t PackMaterialInfo(const MaterialInfo& info);
+MaterialInfo UnpackMaterialInfo(uint64_t entry);
+
+uint64_t MaterialKeyDelta(unsigned int piece)
+{
+	assert(piece < N_PIECES);
+	return uint64_t(1) << (4 * piece);
+}
+
+unsigned int MaterialCount(uint64_t materialKey, unsigned int piece)
+{
+	assert(piece < N_PIECES);
+	return (materialKey >> (4 * piece)) & 0xF;
+}
+
+MaterialInfo MaterialTable::Probe(uint64_t materialKey)
+{
+	assert((materialKey & ~(UNIVERCE >> 16)) == 0);
+
+	size_t index = ((materialKey * 0x9E3779B97F4A7C15) >> 32) & (SIZE - 1);
+	uint64_t entry = table[index].load(std::memory_order_relaxed);
+
+	if ((entry >> 16) == materialKey)
+		return UnpackMaterialInfo(entry);
+
+	MaterialInfo info = CalculateMaterialInfo(materialKey);
+	table[index].store((materialKey << 16) | PackMaterialInfo(info), std::memory_order_relaxed);
+	return info;
+}
+
+MaterialInfo CalculateMaterialInfo(uint64_t materialKey)
+{
+	MaterialInfo info;
+
+	for (unsigned int piece = 0; piece < N_PIECES; piece++)
+	{
+		info.pieceCount += MaterialCount(materialKey, piece);
+	}
+
+	unsigned int kingsAndPawns = MaterialCount(materialKey, WHITE_KING) + MaterialCount(materialKey, BLACK_KING) + MaterialCount(materialKey, WHITE_PAWN) + MaterialCount(materialKey, BLACK_PAWN);
+	info.pawnEndgame = info.pieceCount == kingsAndPawns;
+
+	unsigned int heavy = MaterialCount(materialKey, WHITE_PAWN) + MaterialCount(materialKey, WHITE_ROOK) + MaterialCount(materialKey, WHITE_QUEEN)
+		+ MaterialCount(materialKey, BLACK_PAWN) + MaterialCount(materialKey, BLACK_ROOK) + MaterialCount(materialKey, BLACK_QUEEN);
+
+	/*
+	From the Chess Programming Wiki:
+		According to the rules of a dead position, Article 5.2 b, when there is no possibility of checkmate for either side with any series of legal moves, the position is an immediate draw if
+		- both sides have a bare king													1.
+		- one side has a king and a minor piece against a bare king						2.
+		- both sides have a king and a bishop, the bishops being the same color			Not covered
+	*/
+
+	if (heavy == 0)
+	{
+		unsigned int WhiteMinor = MaterialCount(materialKey, WHITE_BISHOP) + MaterialCount(materialKey, WHITE_KNIGHT);
+		unsigned int BlackMinor = MaterialCount(materialKey, BLACK_BISHOP) + MaterialCount(materialKey, BLACK_KNIGHT);
+
+		info.deadPosition = WhiteMinor + BlackMinor <= 1;	//1 and 2
+	}
+
+	return info;
+}
+
+uint64_t PackMaterialInfo(const MaterialInfo& info)
+{
+	assert(info.pieceCount <= PIECE_COUNT_BITS);
+
+	return info.pieceCount
+		| (info.deadPosition ? DEAD_POSITION_BIT : 0)
+		| (info.pawnEndgame ? PAWN_ENDGAME_BIT : 0);
+}
+
+MaterialInfo UnpackMaterialInfo(uint64_t entry)
+{
+	MaterialInfo info;
+	info.pieceCount = entry & PIECE_COUNT_BITS;
+	info.deadPosition = (entry & DEAD_POSITION_BIT) != 0;
+	info.pawnEndgame = (entry & PAWN_ENDGAME_BIT) != 0;
+	return info;
+}
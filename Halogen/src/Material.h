@@ -0,0 +1,34 @@
+#pragma once
+#include "BitBoardDefine.h"
+#include <atomic>
+#include <stdint.h>
+
+/*
+The material key packs how many of each of the 12 pieces there are into 4 bits each, so adding or removing a piece is a single add or
+subtract, and two positions have the same key exactly when they have the same material. BitBoard keeps it up to date in SetSquare and ClearSquare.
+
+Everything we can tell from the material alone goes in a material table shared by all the search threads. Like the evalCache each entry
+is a single 64 bit word: the 48 bit material key in the high bits and the information in the low 16, so a lookup checks the whole key.
+*/
+
+uint64_t MaterialKeyDelta(unsigned int piece);							//what one more of this piece adds to the material key
+unsigned int MaterialCount(uint64_t materialKey, unsigned int piece);	//how many of this piece there are
+
+struct MaterialInfo
+{
+	bool deadPosition = false;			//neither side can possibly checkmate
+	bool pawnEndgame = false;			//only kings and pawns are left
+	unsigned int pieceCount = 0;		//including the kings. We keep the count rather than a tablebase flag because TB_LARGEST changes with the SyzygyPath
+};
+
+class MaterialTable
+{
+public:
+	MaterialInfo Probe(uint64_t materialKey);		//works it out and stores it if it isn't there yet
+
+private:
+	static constexpr size_t SIZE = 4096;			//far more than the number of different material balances a search will come across
+	std::atomic<uint64_t> table[SIZE];				//static storage so it starts zeroed, and no real position has a material key of zero
+};
+
+extern MaterialTable materialTable;
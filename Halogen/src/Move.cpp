@@ -28,10 +28,7 @@ Move::Move(unsigned int from, unsigned int to, unsigned int flag)
 Move::Move(unsigned short bits)
 {
 	data = bits;
-}
-
-Move::~Move()
-{
+	orderScore = 0;
 }
 
 unsigned int Move::GetFrom() const
@@ -26,7 +26,6 @@ public:
 	Move();
 	Move(unsigned int from, unsigned int to, unsigned int flag);
 	Move(unsigned short bits);
-	~Move();
 
 	unsigned int GetFrom() const;
 	unsigned int GetTo() const;
@@ -1,42 +1,41 @@
 #include "MoveGeneration.h"
 
-void GenerateLegalMoves(Position& position, std::vector<Move>& moves, uint64_t pinned);
-void AddQuiescenceMoves(Position& position, std::vector<Move>& moves, uint64_t pinned);	//captures and/or promotions
+void GenerateLegalMoves(Position& position, MoveList& moves, uint64_t pinned);
+void AddQuiescenceMoves(Position& position, MoveList& moves, uint64_t pinned);	//captures and/or promotions
+void AddQuietMoves(Position& position, MoveList& moves, uint64_t pinned);
 
 //Pawn moves
-void PawnPushes(Position& position, std::vector<Move>& moves, uint64_t pinned);
-void PawnPromotions(Position& position, std::vector<Move>& moves, uint64_t pinned);
-void PawnDoublePushes(Position& position, std::vector<Move>& moves, uint64_t pinned);
-void PawnEnPassant(Position& position, std::vector<Move>& moves);	//Ep moves are always checked for legality so no need for pinned mask
-void PawnCaptures(Position& position, std::vector<Move>& moves, uint64_t pinned);
+void PawnPushes(Position& position, MoveList& moves, uint64_t pinned);
+void PawnPromotions(Position& position, MoveList& moves, uint64_t pinned);
+void PawnDoublePushes(Position& position, MoveList& moves, uint64_t pinned);
+void PawnEnPassant(Position& position, MoveList& moves);	//Ep moves are always checked for legality so no need for pinned mask
+void PawnCaptures(Position& position, MoveList& moves, uint64_t pinned);
 
 //All other pieces
-void GenerateQuietMoves(Position& position, std::vector<Move>& moves, unsigned int square, uint64_t attackMask[N_SQUARES], bool isSliding, uint64_t pinned);
-void GenerateCaptureMoves(Position& position, std::vector<Move>& moves, unsigned int square, uint64_t attackMask[N_SQUARES], bool isSliding, uint64_t pinned);
+void GenerateQuietMoves(Position& position, MoveList& moves, unsigned int square, unsigned int pieceType, uint64_t pinned);
+void GenerateCaptureMoves(Position& position, MoveList& moves, unsigned int square, unsigned int pieceType, uint64_t pinned);
 
 //misc
-void CastleMoves(const Position& position, std::vector<Move>& moves);
+void CastleMoves(const Position& position, MoveList& moves);
 
 //utility functions
 bool MovePutsSelfInCheck(Position& position, const Move& move);
+bool IsSquareThreatened(const Position& position, unsigned int square, bool colour, uint64_t occupied);
 uint64_t PinnedMask(const Position& position);
 
 //special generators for when in check
-void KingEvasions(Position& position, std::vector<Move>& moves);						//move the king out of danger	(single or multi threat)
-void KingCapturesEvade(Position& position, std::vector<Move>& moves);			//use only for multi threat with king evasions
-void CaptureThreat(Position& position, std::vector<Move>& moves, uint64_t threats);		//capture the attacker	(single threat only)
-void BlockThreat(Position& position, std::vector<Move>& moves, uint64_t threats);		//block the attacker (single threat only)
+void KingEvasions(Position& position, MoveList& moves);						//move the king out of danger	(single or multi threat)
+void KingCapturesEvade(Position& position, MoveList& moves);			//use only for multi threat with king evasions
+void CaptureThreat(Position& position, MoveList& moves, uint64_t threats);		//capture the attacker	(single threat only)
+void BlockThreat(Position& position, MoveList& moves, uint64_t threats);		//block the attacker (single threat only)
 
-void LegalMoves(Position& position, std::vector<Move>& moves)
+void LegalMoves(Position& position, MoveList& moves)
 {
 	uint64_t pinned = PinnedMask(position);
 
-	if (IsInCheck(position, position.GetTurn()))
+	if (position.GetCheckers() != EMPTY)
 	{
-		moves.reserve(10);
-
-		uint64_t Threats = GetThreats(position, position.GetKing(position.GetTurn()), position.GetTurn());
-		assert(Threats != 0);
+		uint64_t Threats = position.GetCheckers();
 
 		if (GetBitCount(Threats) > 1)					//double check
 		{
@@ -59,81 +58,50 @@ void LegalMoves(Position& position, std::vector<Move>& moves)
 	}
 	else
 	{
-		moves.reserve(50);
 		GenerateLegalMoves(position, moves, pinned);
 	}
 }
 
-void QuiescenceMoves(Position& position, std::vector<Move>& moves)
+void QuiescenceMoves(Position& position, MoveList& moves)
 {
-	moves.reserve(15);
 	AddQuiescenceMoves(position, moves, PinnedMask(position));
 }
 
-void AddQuiescenceMoves(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void PseudoLegalMoves(Position& position, MoveList& moves)
+{
+	GenerateLegalMoves(position, moves, EMPTY);	//with nothing marked as pinned, only en passant gets checked
+}
+
+void PseudoQuiescenceMoves(Position& position, MoveList& moves)
+{
+	AddQuiescenceMoves(position, moves, EMPTY);
+}
+
+void PseudoQuietMoves(Position& position, MoveList& moves)
+{
+	AddQuietMoves(position, moves, EMPTY);
+}
+
+void AddQuiescenceMoves(Position& position, MoveList& moves, uint64_t pinned)
 {
 	PawnCaptures(position, moves, pinned);
 	PawnEnPassant(position, moves);
 	PawnPromotions(position, moves, pinned);
 
-	for (uint64_t pieces = position.GetPieceBB(KNIGHT, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), KnightAttacks, false, pinned));
-	for (uint64_t pieces = position.GetPieceBB(BISHOP, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), BishopAttacks, true, pinned));
-	for (uint64_t pieces = position.GetPieceBB(KING, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), KingAttacks, false, pinned));
-	for (uint64_t pieces = position.GetPieceBB(ROOK, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), RookAttacks, true, pinned));
-	for (uint64_t pieces = position.GetPieceBB(QUEEN, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), QueenAttacks, true, pinned));
+	for (uint64_t pieces = position.GetPieceBB(KNIGHT, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), KNIGHT, pinned));
+	for (uint64_t pieces = position.GetPieceBB(BISHOP, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), BISHOP, pinned));
+	for (uint64_t pieces = position.GetPieceBB(KING, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), KING, pinned));
+	for (uint64_t pieces = position.GetPieceBB(ROOK, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), ROOK, pinned));
+	for (uint64_t pieces = position.GetPieceBB(QUEEN, position.GetTurn()); pieces != 0; GenerateCaptureMoves(position, moves, LSPpop(pieces), QUEEN, pinned));
 }
 
 uint64_t PinnedMask(const Position& position)
 {
-	bool turn = position.GetTurn();
-	unsigned int king = position.GetKing(turn);
-	if (IsSquareThreatened(position, king, turn)) return UNIVERCE;
-
-	uint64_t mask = EMPTY;
-	uint64_t possiblePins = QueenAttacks[king] & position.GetPiecesColour(turn);
-	uint64_t maskAll = position.GetAllPieces();
-
-	while (possiblePins != 0)
-	{
-		unsigned int sq = LSPpop(possiblePins);
-
-		if (!mayMove(king, sq, maskAll))	//if you can't move from the square to the king, it can't be pinned
-			continue;
-
-		//If a piece is moving from the same diagonal as the king, and that diagonal contains an enemy bishop or queen
-		if ((GetDiagonal(king) == GetDiagonal(sq)) && (DiagonalBB[GetDiagonal(king)] & (position.GetPieceBB(BISHOP, !turn) | position.GetPieceBB(QUEEN, !turn))))
-		{
-			mask |= SquareBB[sq];
-			continue;
-		}
-
-		//If a piece is moving from the same anti-diagonal as the king, and that diagonal contains an enemy bishop or queen
-		if ((GetAntiDiagonal(king) == GetAntiDiagonal(sq)) && (AntiDiagonalBB[GetAntiDiagonal(king)] & (position.GetPieceBB(BISHOP, !turn) | position.GetPieceBB(QUEEN, !turn))))
-		{
-			mask |= SquareBB[sq];
-			continue;
-		}
-
-		//If a piece is moving from the same file as the king, and that file contains an enemy rook or queen
-		if ((GetFile(king) == GetFile(sq)) && (FileBB[GetFile(king)] & (position.GetPieceBB(ROOK, !turn) | position.GetPieceBB(QUEEN, !turn))))
-		{
-			mask |= SquareBB[sq];
-			continue;
-		}
-
-		//If a piece is moving from the same rank as the king, and that rank contains an enemy rook or queen
-		if ((GetRank(king) == GetRank(sq)) && (RankBB[GetRank(king)] & (position.GetPieceBB(ROOK, !turn) | position.GetPieceBB(QUEEN, !turn))))
-		{
-			mask |= SquareBB[sq];
-			continue;
-		}
-	}
-
-	mask |= SquareBB[king];
-	return mask;
+	if (position.GetCheckers() != EMPTY) return UNIVERCE;
+	return position.GetCheckInfo().pinned | position.GetPieceBB(KING, position.GetTurn());
 }
 
-void KingEvasions(Position& position, std::vector<Move>& moves)
+void KingEvasions(Position& position, MoveList& moves)
 {
 	unsigned int square = position.GetKing(position.GetTurn());
 	uint64_t quiet = position.GetEmptySquares() & KingAttacks[square];
@@ -143,12 +111,12 @@ void KingEvasions(Position& position, std::vector<Move>& moves)
 		unsigned int target = LSPpop(quiet);
 		Move move(square, target, QUIET);
 
-		if (!MovePutsSelfInCheck(position, move))
+		if (IsLegal(position, move))
 			moves.push_back(move);
 	}
 }
 
-void KingCapturesEvade(Position& position, std::vector<Move>& moves)
+void KingCapturesEvade(Position& position, MoveList& moves)
 {
 	unsigned int square = position.GetKing(position.GetTurn());
 	uint64_t captures = (position.GetPiecesColour(!position.GetTurn())) & KingAttacks[square];
@@ -158,12 +126,12 @@ void KingCapturesEvade(Position& position, std::vector<Move>& moves)
 		unsigned int target = LSPpop(captures);
 		Move move(square, target, CAPTURE);
 
-		if (!MovePutsSelfInCheck(position, move))
+		if (IsLegal(position, move))
 			moves.push_back(move);
 	}
 }
 
-void CaptureThreat(Position& position, std::vector<Move>& moves, uint64_t threats)
+void CaptureThreat(Position& position, MoveList& moves, uint64_t threats)
 {
 	unsigned int threatSquare = LSPpop(threats);
 
@@ -176,12 +144,12 @@ void CaptureThreat(Position& position, std::vector<Move>& moves, uint64_t threat
 		unsigned int start = LSPpop(potentialCaptures);
 		Move move(start, threatSquare, CAPTURE);
 
-		if (!MovePutsSelfInCheck(position, move))
+		if (IsLegal(position, move))
 			moves.push_back(move);
 	}
 }
 
-void BlockThreat(Position& position, std::vector<Move>& moves, uint64_t threats)
+void BlockThreat(Position& position, MoveList& moves, uint64_t threats)
 {
 	unsigned int threatSquare = LSPpop(threats);
 	unsigned int piece = position.GetSquare(threatSquare);
@@ -200,28 +168,32 @@ void BlockThreat(Position& position, std::vector<Move>& moves, uint64_t threats)
 			unsigned int start = LSPpop(potentialBlockers);
 			Move move(start, sq, QUIET);
 
-			if (!MovePutsSelfInCheck(position, move))
+			if (IsLegal(position, move))
 				moves.push_back(move);
 		}
 	}
 }
 
-void GenerateLegalMoves(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void GenerateLegalMoves(Position& position, MoveList& moves, uint64_t pinned)
+{
+	AddQuietMoves(position, moves, pinned);
+	AddQuiescenceMoves(position, moves, pinned);
+}
+
+void AddQuietMoves(Position& position, MoveList& moves, uint64_t pinned)
 {
 	PawnPushes(position, moves, pinned);
 	PawnDoublePushes(position, moves, pinned);
 	CastleMoves(position, moves);
 
-	for (uint64_t pieces = position.GetPieceBB(KNIGHT, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), KnightAttacks, false, pinned));
-	for (uint64_t pieces = position.GetPieceBB(BISHOP, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), BishopAttacks, true, pinned));
-	for (uint64_t pieces = position.GetPieceBB(QUEEN, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), QueenAttacks, true, pinned));
-	for (uint64_t pieces = position.GetPieceBB(ROOK, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), RookAttacks, true, pinned));
-	for (uint64_t pieces = position.GetPieceBB(KING, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), KingAttacks, false, pinned));
-
-	AddQuiescenceMoves(position, moves, pinned);
+	for (uint64_t pieces = position.GetPieceBB(KNIGHT, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), KNIGHT, pinned));
+	for (uint64_t pieces = position.GetPieceBB(BISHOP, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), BISHOP, pinned));
+	for (uint64_t pieces = position.GetPieceBB(QUEEN, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), QUEEN, pinned));
+	for (uint64_t pieces = position.GetPieceBB(ROOK, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), ROOK, pinned));
+	for (uint64_t pieces = position.GetPieceBB(KING, position.GetTurn()); pieces != 0; GenerateQuietMoves(position, moves, LSPpop(pieces), KING, pinned));
 }
 
-void PawnPushes(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void PawnPushes(Position& position, MoveList& moves, uint64_t pinned)
 {
 	int foward = 0;
 	uint64_t targets = 0;
@@ -245,12 +217,12 @@ void PawnPushes(Position& position, std::vector<Move>& moves, uint64_t pinned)
 		unsigned int end = LSPpop(pawnPushes);
 		Move move(end - foward, end, QUIET);
 
-		if (!(pinned & SquareBB[end- foward]) || !MovePutsSelfInCheck(position, move))
+		if (!(pinned & SquareBB[end- foward]) || IsLegal(position, move))
 			moves.push_back(move);
 	}
 }
 
-void PawnPromotions(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void PawnPromotions(Position& position, MoveList& moves, uint64_t pinned)
 {
 	int foward = 0;
 	uint64_t targets = 0;
@@ -274,7 +246,7 @@ void PawnPromotions(Position& position, std::vector<Move>& moves, uint64_t pinne
 		unsigned int end = LSPpop(pawnPromotions);
 
 		Move move(end - foward, end, KNIGHT_PROMOTION);
-		if ((pinned & SquareBB[end - foward]) && MovePutsSelfInCheck(position, move))
+		if ((pinned & SquareBB[end - foward]) && !IsLegal(position, move))
 			continue;
 
 		moves.push_back(move);
@@ -284,7 +256,7 @@ void PawnPromotions(Position& position, std::vector<Move>& moves, uint64_t pinne
 	}
 }
 
-void PawnDoublePushes(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void PawnDoublePushes(Position& position, MoveList& moves, uint64_t pinned)
 {
 	int foward = 0;
 	uint64_t targets = 0;
@@ -310,12 +282,12 @@ void PawnDoublePushes(Position& position, std::vector<Move>& moves, uint64_t pin
 		unsigned int end = LSPpop(targets);
 		Move move(end - foward, end, PAWN_DOUBLE_MOVE);
 
-		if (!(pinned & SquareBB[end - foward]) || !MovePutsSelfInCheck(position, move))
+		if (!(pinned & SquareBB[end - foward]) || IsLegal(position, move))
 			moves.push_back(move);
 	}
 }
 
-void PawnEnPassant(Position& position, std::vector<Move>& moves)
+void PawnEnPassant(Position& position, MoveList& moves)
 {
 	if (position.GetEnPassant() <= SQ_H8)
 	{
@@ -347,7 +319,7 @@ void PawnEnPassant(Position& position, std::vector<Move>& moves)
 	}
 }
 
-void PawnCaptures(Position& position, std::vector<Move>& moves, uint64_t pinned)
+void PawnCaptures(Position& position, MoveList& moves, uint64_t pinned)
 {
 	int fowardleft = 0;
 	int fowardright = 0;
@@ -375,7 +347,7 @@ void PawnCaptures(Position& position, std::vector<Move>& moves, uint64_t pinned)
 		unsigned int end = LSPpop(leftAttack);
 
 		Move move(end - fowardleft, end, CAPTURE);
-		if ((pinned & SquareBB[end - fowardleft]) && MovePutsSelfInCheck(position, move))
+		if ((pinned & SquareBB[end - fowardleft]) && !IsLegal(position, move))
 			continue;
 
 		if (GetRank(end) == RANK_1 || GetRank(end) == RANK_8)
@@ -394,7 +366,7 @@ void PawnCaptures(Position& position, std::vector<Move>& moves, uint64_t pinned)
 		unsigned int end = LSPpop(rightAttack);
 
 		Move move(end - fowardright, end, CAPTURE);
-		if ((pinned & SquareBB[end - fowardright]) && MovePutsSelfInCheck(position, move))
+		if ((pinned & SquareBB[end - fowardright]) && !IsLegal(position, move))
 			continue;
 
 		if (GetRank(end) == RANK_1 || GetRank(end) == RANK_8)
@@ -409,7 +381,7 @@ void PawnCaptures(Position& position, std::vector<Move>& moves, uint64_t pinned)
 	}
 }
 
-void CastleMoves(const Position& position, std::vector<Move>& moves)
+void CastleMoves(const Position& position, MoveList& moves)
 {
 	uint64_t Pieces = position.GetAllPieces();
 
@@ -458,51 +430,48 @@ void CastleMoves(const Position& position, std::vector<Move>& moves)
 	}
 }
 
-void GenerateQuietMoves(Position& position, std::vector<Move>& moves, unsigned int square, uint64_t attackMask[N_SQUARES], bool isSliding, uint64_t pinned)
+void GenerateQuietMoves(Position& position, MoveList& moves, unsigned int square, unsigned int pieceType, uint64_t pinned)
 {
 	assert(square < N_SQUARES);
 
-	uint64_t quiet = position.GetEmptySquares() & attackMask[square];
-	uint64_t maskall = position.GetAllPieces() & attackMask[square];
+	uint64_t quiet = position.GetEmptySquares() & AttackBB(pieceType, square, position.GetAllPieces());
 
 	while (quiet != 0)
 	{
 		unsigned int target = LSPpop(quiet);
-		if (!isSliding || mayMove(square, target, maskall))
-		{
-			Move move(square, target, QUIET);
+		Move move(square, target, QUIET);
 
-			if ((pinned & SquareBB[square]) && MovePutsSelfInCheck(position, move))
-				continue;
+		if ((pinned & SquareBB[square]) && !IsLegal(position, move))
+			continue;
 
-			moves.push_back(move);
-		}
+		moves.push_back(move);
 	}
 }
 
-void GenerateCaptureMoves(Position& position, std::vector<Move>& moves, unsigned int square, uint64_t attackMask[N_SQUARES], bool isSliding, uint64_t pinned)
+void GenerateCaptureMoves(Position& position, MoveList& moves, unsigned int square, unsigned int pieceType, uint64_t pinned)
 {
 	assert(square < N_SQUARES);
 
-	uint64_t captures = (position.GetPiecesColour(!position.GetTurn())) & attackMask[square];
-	uint64_t maskall = position.GetAllPieces() & attackMask[square];
+	uint64_t captures = position.GetPiecesColour(!position.GetTurn()) & AttackBB(pieceType, square, position.GetAllPieces());
 
 	while (captures != 0)
 	{
 		unsigned int target = LSPpop(captures);
-		if (!isSliding || mayMove(square, target, maskall))
-		{
-			Move move(square, target, CAPTURE);
+		Move move(square, target, CAPTURE);
 
-			if ((pinned & SquareBB[square]) && MovePutsSelfInCheck(position, move))
-				continue;
+		if ((pinned & SquareBB[square]) && !IsLegal(position, move))
+			continue;
 
-			moves.push_back(move);
-		}
+		moves.push_back(move);
 	}
 }
 
 bool IsSquareThreatened(const Position& position, unsigned int square, bool colour)
+{
+	return IsSquareThreatened(position, square, colour, position.GetAllPieces());
+}
+
+bool IsSquareThreatened(const Position& position, unsigned int square, bool colour, uint64_t Pieces)
 {
 	assert(square < N_SQUARES);
 
@@ -524,31 +493,13 @@ bool IsSquareThreatened(const Position& position, unsigned int square, bool colo
 	if ((KingAttacks[square] & position.GetPieceBB(KING, !colour)) != 0)					//if I can attack the enemy king he can attack me
 		return true;
 
-	uint64_t Pieces = position.GetAllPieces();
-	
-	uint64_t queen = position.GetPieceBB(QUEEN, !colour) & QueenAttacks[square];
-	while (queen != 0)
-	{
-		unsigned int start = LSPpop(queen);
-		if (mayMove(start, square, Pieces))
-			return true;
-	}
+	uint64_t queens = position.GetPieceBB(QUEEN, !colour);
 
-	uint64_t bishops = position.GetPieceBB(BISHOP, !colour) & BishopAttacks[square];
-	while (bishops != 0)
-	{
-		unsigned int start = LSPpop(bishops);
-		if (mayMove(start, square, Pieces))
-			return true;
-	}
+	if ((GetBishopAttacks(square, Pieces) & (position.GetPieceBB(BISHOP, !colour) | queens)) != 0)
+		return true;
 
-	uint64_t rook = position.GetPieceBB(ROOK, !colour) & RookAttacks[square];
-	while (rook != 0)
-	{
-		unsigned int start = LSPpop(rook);
-		if (mayMove(start, square, Pieces))
-			return true;
-	}
+	if ((GetRookAttacks(square, Pieces) & (position.GetPieceBB(ROOK, !colour) | queens)) != 0)
+		return true;
 
 	return false;
 }
@@ -560,7 +511,7 @@ bool IsInCheck(const Position& position, bool colour)
 
 bool IsInCheck(const Position& position)
 {
-	return IsInCheck(position, position.GetTurn());
+	return position.GetCheckers() != EMPTY;
 }
 
 uint64_t GetThreats(const Position& position, unsigned int square, bool colour)
@@ -583,93 +534,26 @@ uint64_t GetThreats(const Position& position, unsigned int square, bool colour)
 	threats |= (KingAttacks[square] & position.GetPieceBB(KING, !colour));					//if I can attack the enemy king he can attack me
 
 	uint64_t Pieces = position.GetAllPieces();
+	uint64_t queens = position.GetPieceBB(QUEEN, !colour);
 
-	uint64_t queen = position.GetPieceBB(QUEEN, !colour) & QueenAttacks[square];
-	while (queen != 0)
-	{
-		unsigned int start = LSPpop(queen);
-		if (mayMove(start, square, Pieces))
-			threats |= SquareBB[start];
-	}
-
-	uint64_t bishops = position.GetPieceBB(BISHOP, !colour) & BishopAttacks[square];
-	while (bishops != 0)
-	{
-		unsigned int start = LSPpop(bishops);
-		if (mayMove(start, square, Pieces))
-			threats |= SquareBB[start];
-	}
-
-	uint64_t rook = position.GetPieceBB(ROOK, !colour) & RookAttacks[square];
-	while (rook != 0)
-	{
-		unsigned int start = LSPpop(rook);
-		if (mayMove(start, square, Pieces))
-			threats |= SquareBB[start];
-	}
+	threats |= GetBishopAttacks(square, Pieces) & (position.GetPieceBB(BISHOP, !colour) | queens);
+	threats |= GetRookAttacks(square, Pieces) & (position.GetPieceBB(ROOK, !colour) | queens);
 
 	return threats;
 }
 
-Move GetSmallestAttackerMove(const Position& position, unsigned int square, bool colour)
+uint64_t AttackersTo(const Position& position, unsigned int square, uint64_t occupied)
 {
 	assert(square < N_SQUARES);
 
-	uint64_t pawnmask = 0;
-	if (colour == BLACK)
-	{
-		pawnmask = (WhitePawnAttacks[square] & position.GetPieceBB(BLACK_PAWN));
-	}
-
-	if (colour == WHITE)
-	{
-		pawnmask = (BlackPawnAttacks[square] & position.GetPieceBB(WHITE_PAWN));
-	}
-
-	if (pawnmask != 0)
-	{
-		return(Move(LSPpop(pawnmask), square, CAPTURE));
-	}
-
-	uint64_t knightmask = (KnightAttacks[square] & position.GetPieceBB(KNIGHT, colour));
-	if (knightmask != 0)
-	{
-		return(Move(LSPpop(knightmask), square, CAPTURE));
-	}
-
-	uint64_t Pieces = position.GetAllPieces();
-
-	uint64_t bishops = position.GetPieceBB(BISHOP, colour) & BishopAttacks[square];
-	while (bishops != 0)
-	{
-		unsigned int start = LSPpop(bishops);
-		if (mayMove(start, square, Pieces))
-			return Move(start, square, CAPTURE);
-	}
-
-	uint64_t rook = position.GetPieceBB(ROOK, colour) & RookAttacks[square];
-	while (rook != 0)
-	{
-		unsigned int start = LSPpop(rook);
-		if (mayMove(start, square, Pieces))
-			return Move(start, square, CAPTURE);
-	}
-
-	uint64_t queen = position.GetPieceBB(QUEEN, colour) & QueenAttacks[square];
-	while (queen != 0)
-	{
-		unsigned int start = LSPpop(queen);
-		if (mayMove(start, square, Pieces))
-			return Move(start, square, CAPTURE);
-	}
-
-	uint64_t kingmask = (KingAttacks[square] & position.GetPieceBB(KING, colour));
-	if (kingmask != 0)
-	{
-		return(Move(LSPpop(kingmask), square, CAPTURE));
-	}
+	uint64_t queens = position.GetPieceBB(WHITE_QUEEN) | position.GetPieceBB(BLACK_QUEEN);
 
-	return Move();
+	return (BlackPawnAttacks[square] & position.GetPieceBB(WHITE_PAWN))
+		| (WhitePawnAttacks[square] & position.GetPieceBB(BLACK_PAWN))
+		| (KnightAttacks[square] & (position.GetPieceBB(WHITE_KNIGHT) | position.GetPieceBB(BLACK_KNIGHT)))
+		| (KingAttacks[square] & (position.GetPieceBB(WHITE_KING) | position.GetPieceBB(BLACK_KING)))
+		| (GetBishopAttacks(square, occupied) & (position.GetPieceBB(WHITE_BISHOP) | position.GetPieceBB(BLACK_BISHOP) | queens))
+		| (GetRookAttacks(square, occupied) & (position.GetPieceBB(WHITE_ROOK) | position.GetPieceBB(BLACK_ROOK) | queens));
 }
 
 bool MoveIsLegal(Position& position, const Move& move)
@@ -702,6 +586,24 @@ bool MoveIsLegal(Position& position, const Move& move)
 		if (position.GetSquare(move.GetFrom()) != WHITE_PAWN && position.GetSquare(move.GetFrom()) != BLACK_PAWN)
 			return false;
 
+	/*Make sure the flag agrees with the board. Killers and hash moves can come from a different position with the same squares*/
+	if (!move.IsCapture() && position.GetSquare(move.GetTo()) != N_PIECES)
+		return false;
+
+	bool isPawn = piece == WHITE_PAWN || piece == BLACK_PAWN;
+
+	if (move.IsPromotion() != (isPawn && (GetRank(move.GetTo()) == RANK_1 || GetRank(move.GetTo()) == RANK_8)))
+		return false;
+
+	if ((move.GetFlag() == PAWN_DOUBLE_MOVE) != (isPawn && AbsRankDiff(move.GetFrom(), move.GetTo()) == 2))
+		return false;
+
+	if (move.GetFlag() == EN_PASSANT && (!isPawn || position.GetEnPassant() != move.GetTo()))
+		return false;
+
+	if (isPawn && FileDiff(move.GetFrom(), move.GetTo()) != 0 && !move.IsCapture())
+		return false;
+
 	uint64_t allPieces = position.GetAllPieces();
 
 	/*Sliding pieces*/
@@ -805,7 +707,7 @@ bool MoveIsLegal(Position& position, const Move& move)
 
 	if (move.GetFlag() == KING_CASTLE || move.GetFlag() == QUEEN_CASTLE)
 	{
-		std::vector<Move> moves;
+		MoveList moves;
 		CastleMoves(position, moves);
 
 		bool present = false;
@@ -820,8 +722,38 @@ bool MoveIsLegal(Position& position, const Move& move)
 	}
 
 	/*Move puts me in check*/
-	if (MovePutsSelfInCheck(position, move))
-		return false;
+	return IsLegal(position, move);
+}
+
+bool IsLegal(Position& position, const Move& move)
+{
+	bool turn = position.GetTurn();
+	unsigned int king = position.GetKing(turn);
+	const CheckInfo& checkInfo = position.GetCheckInfo();
+
+	if (move.GetFrom() == king)
+	{
+		if (move.GetFlag() == KING_CASTLE || move.GetFlag() == QUEEN_CASTLE)	//CastleMoves has already checked every square the king crosses
+			return true;
+
+		return !IsSquareThreatened(position, move.GetTo(), turn, position.GetAllPieces() ^ SquareBB[king]);	//take the king off so it can't hide behind itself from a slider
+	}
+
+	if (move.GetFlag() == EN_PASSANT)		//two pieces leave the same rank, which can uncover the king sideways. Rare enough to just try it
+		return !MovePutsSelfInCheck(position, move);
+
+	if (checkInfo.checkers != EMPTY)
+	{
+		if (GetBitCount(checkInfo.checkers) > 1)	//double check: only the king can move
+			return false;
+
+		unsigned int checker = LSB(checkInfo.checkers);
+		if (((SquareBB[checker] | inBetweenCache(king, checker)) & SquareBB[move.GetTo()]) == 0)	//must capture or block the checker
+			return false;
+	}
+
+	if (checkInfo.pinned & SquareBB[move.GetFrom()])		//a pinned piece has to stay on the line through the king
+		return (inBetweenCache(king, move.GetTo()) & SquareBB[move.GetFrom()]) != 0 || (inBetweenCache(king, move.GetFrom()) & SquareBB[move.GetTo()]) != 0;
 
 	return true;
 }
@@ -1,16 +1,23 @@
 #pragma once
 #include "Position.h"
 #include "EvalNet.h"
+#include "MoveList.h"
 
-void LegalMoves(Position& position, std::vector<Move>& moves);
-void QuiescenceMoves(Position& position, std::vector<Move>& moves);
+void LegalMoves(Position& position, MoveList& moves);
+void QuiescenceMoves(Position& position, MoveList& moves);
+
+//The same moves without checking if they leave our king in check, which is most of the cost of generating them. Check each one with IsLegal before playing it
+void PseudoLegalMoves(Position& position, MoveList& moves);
+void PseudoQuiescenceMoves(Position& position, MoveList& moves);
+void PseudoQuietMoves(Position& position, MoveList& moves);			//the moves PseudoLegalMoves gives that PseudoQuiescenceMoves doesn't
+bool IsLegal(Position& position, const Move& move);					//for a move from the generators: does it leave our king safe
 
 bool IsSquareThreatened(const Position & position, unsigned int square, bool colour);		//will tell you if the king WOULD be threatened on that square. Useful for finding defended / threatening pieces
 bool IsInCheck(const Position& position, bool colour);	
-bool IsInCheck(const Position& position);
+bool IsInCheck(const Position& position);			//the side to move. Uses the check info the position keeps, so it's free
 uint64_t GetThreats(const Position& position, unsigned int square, bool colour);	//colour is of the attacked piece! So to get the black threats of a white piece pass colour = WHITE!
 
-Move GetSmallestAttackerMove(const Position& position, unsigned int square, bool colour);
+uint64_t AttackersTo(const Position& position, unsigned int square, uint64_t occupied);		//pieces of both colours attacking the square, with sliders seeing through anything not in occupied
 
 bool MoveIsLegal(Position& position, const Move& move);
 
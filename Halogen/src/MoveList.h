@@ -0,0 +1,46 @@
+#pragma once
+#include "Move.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+constexpr size_t MAX_MOVES = 256;		//no legal position has more than 218 moves
+
+static_assert(std::is_trivially_copyable<Move>::value && std::is_trivially_destructible<Move>::value, "MoveList never destroys its moves");
+
+/*
+A list of moves with a fixed capacity that lives on the stack, so that generating the moves at a node never touches the heap.
+The storage is left uninitialised and only the moves that are added get constructed.
+*/
+class MoveList
+{
+public:
+	MoveList() : count(0) {}
+
+	void push_back(const Move& move)
+	{
+		assert(count < MAX_MOVES);
+		new (&storage[count++]) Move(move);
+	}
+
+	void clear() { count = 0; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	Move* data() { return reinterpret_cast<Move*>(storage); }
+	const Move* data() const { return reinterpret_cast<const Move*>(storage); }
+
+	Move& operator[](size_t i) { assert(i < count); return data()[i]; }
+	const Move& operator[](size_t i) const { assert(i < count); return data()[i]; }
+	Move& at(size_t i) { return (*this)[i]; }
+	const Move& at(size_t i) const { return (*this)[i]; }
+
+	Move* begin() { return data(); }
+	Move* end() { return data() + count; }
+	const Move* begin() const { return data(); }
+	const Move* end() const { return data() + count; }
+
+private:
+	typename std::aligned_storage<sizeof(Move), alignof(Move)>::type storage[MAX_MOVES];
+	size_t count;
+};
@@ -0,0 +1,186 @@
+#include "MovePicker.h"
+#include "Search.h"
+
+MovePicker::MovePicker(Position& Position, int DistanceFromRoot, const SearchData& Locals, Move HashMove, bool LoudOnly) :
+	position(Position), locals(Locals), distanceFromRoot(DistanceFromRoot), hashMove(HashMove), loudOnly(LoudOnly), current(0)
+{
+	stage = (!loudOnly && IsInCheck(position)) ? GEN_EVASIONS : GEN_LOUD;
+}
+
+bool MovePicker::Next(Move& move)
+{
+	switch (stage)
+	{
+	case GEN_LOUD:
+		PseudoQuiescenceMoves(position, moves);
+		ScoreLoudMoves();
+		current = 0;
+		stage = GOOD_LOUD;
+		//fall through
+
+	case GOOD_LOUD:
+		while (PickBest(moves, move))
+		{
+			if (move == hashMove || !IsLegal(position, move))
+				continue;
+
+			if (move.IsPromotion() && move.GetFlag() != QUEEN_PROMOTION && move.GetFlag() != QUEEN_PROMOTION_CAPTURE)
+			{
+				badLoud.push_back(move);
+				continue;
+			}
+
+			if (!SeeGE(position, move, 0))
+			{
+				badLoud.push_back(move);
+				continue;
+			}
+
+			return true;
+		}
+
+		stage = loudOnly ? PICKER_DONE : KILLER_ONE;
+		current = 0;
+		return Next(move);
+
+	case KILLER_ONE:
+	case KILLER_TWO:
+	{
+		move = locals.KillerMoves[distanceFromRoot].move[stage == KILLER_ONE ? 0 : 1];
+		stage++;
+
+		if (!move.IsUninitialized() && !(move == hashMove) && MoveIsLegal(position, move))
+			return true;
+
+		return Next(move);
+	}
+
+	case GEN_QUIET:
+		moves.clear();
+		PseudoQuietMoves(position, moves);
+		ScoreQuietMoves();
+		current = 0;
+		stage = QUIET_MOVES;
+		//fall through
+
+	case QUIET_MOVES:
+		while (PickBest(moves, move))
+		{
+			if (move == hashMove || IsKiller(move) || !IsLegal(position, move))
+				continue;
+
+			return true;
+		}
+
+		stage = BAD_LOUD;
+		current = 0;
+		//fall through
+
+	case BAD_LOUD:
+		if (current < badLoud.size())	//in the order they were put aside, which is MVV-LVA
+		{
+			move = badLoud[current++];
+			return true;
+		}
+
+		stage = PICKER_DONE;
+		return false;
+
+	case GEN_EVASIONS:
+		LegalMoves(position, moves);
+		ScoreEvasions();
+		current = 0;
+		stage = EVASIONS;
+		//fall through
+
+	case EVASIONS:
+		while (PickBest(moves, move))
+		{
+			if (move == hashMove)
+				continue;
+
+			return true;
+		}
+
+		stage = PICKER_DONE;
+		return false;
+
+	default:
+		return false;
+	}
+}
+
+bool MovePicker::PickBest(MoveList& list, Move& move)
+{
+	if (current >= list.size())
+		return false;
+
+	size_t best = current;
+
+	for (size_t i = current + 1; i < list.size(); i++)
+	{
+		if (list[i].orderScore > list[best].orderScore)
+			best = i;
+	}
+
+	std::swap(list[current], list[best]);
+	move = list[current++];
+	return true;
+}
+
+void MovePicker::ScoreLoudMoves()
+{
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		int score = 0;
+
+		if (moves[i].GetFlag() == EN_PASSANT)
+			score = 10 * (PAWN + 1) - PAWN;
+		else if (moves[i].IsCapture())
+			score = 10 * (position.GetSquare(moves[i].GetTo()) % N_PIECE_TYPES + 1) - position.GetSquare(moves[i].GetFrom()) % N_PIECE_TYPES;	//most valuable victim, then least valuable attacker
+
+		if (moves[i].GetFlag() == QUEEN_PROMOTION || moves[i].GetFlag() == QUEEN_PROMOTION_CAPTURE)
+			score += 10 * (QUEEN + 1);
+
+		moves[i].orderScore = score;
+	}
+}
+
+void MovePicker::ScoreQuietMoves()
+{
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		moves[i].orderScore = std::min(1000000U, locals.HistoryMatrix[position.GetTurn()][moves[i].GetFrom()][moves[i].GetTo()]);
+	}
+}
+
+void MovePicker::ScoreEvasions()
+{
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		if (moves[i].IsPromotion() && moves[i].GetFlag() != QUEEN_PROMOTION && moves[i].GetFlag() != QUEEN_PROMOTION_CAPTURE)
+			moves[i].orderScore = -1;
+		else if (moves[i].IsCapture() || moves[i].IsPromotion())
+		{
+			int victim = 0;
+
+			if (moves[i].GetFlag() == EN_PASSANT)
+				victim = PAWN;
+			else if (moves[i].IsCapture())
+				victim = position.GetSquare(moves[i].GetTo()) % N_PIECE_TYPES;
+
+			moves[i].orderScore = 8000000 + 10 * victim - position.GetSquare(moves[i].GetFrom()) % N_PIECE_TYPES + (moves[i].IsPromotion() ? 1000 : 0);
+		}
+		else if (moves[i] == locals.KillerMoves[distanceFromRoot].move[0])
+			moves[i].orderScore = 7500000;
+		else if (moves[i] == locals.KillerMoves[distanceFromRoot].move[1])
+			moves[i].orderScore = 6500000;
+		else
+			moves[i].orderScore = std::min(1000000U, locals.HistoryMatrix[position.GetTurn()][moves[i].GetFrom()][moves[i].GetTo()]);
+	}
+}
+
+bool MovePicker::IsKiller(const Move& move) const
+{
+	return move == locals.KillerMoves[distanceFromRoot].move[0] || move == locals.KillerMoves[distanceFromRoot].move[1];
+}
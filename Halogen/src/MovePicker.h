@@ -0,0 +1,58 @@
+#pragma once
+#include "MoveGeneration.h"
+
+struct SearchData;
+
+enum MovePickerStage
+{
+	GEN_LOUD,
+	GOOD_LOUD,
+	KILLER_ONE,
+	KILLER_TWO,
+	GEN_QUIET,
+	QUIET_MOVES,
+	BAD_LOUD,
+
+	GEN_EVASIONS,
+	EVASIONS,
+
+	PICKER_DONE
+};
+
+/*
+Hands out the moves of a position one at a time, best first, generating and scoring each group of moves only once the 
+ones before it have all been used. Most nodes cut off after a move or two, so the rest never get generated or scored.
+Out of check the moves are generated pseudo-legally, and each one is only checked with IsLegal when it is picked.
+
+Captures and promotions are ordered by MVV-LVA, and each is only checked with SeeGE when it is picked: a losing one is put 
+aside to be tried after the quiet moves. Then come the two killers, then the quiet moves by history. When in check all the 
+legal evasions are generated at once: there are only a few and the evasion generators go straight to them. Moves are picked from the remaining ones by selection rather than by sorting the whole list.
+
+The hash move is never returned, because the search tries it before generating anything.
+*/
+class MovePicker
+{
+public:
+	MovePicker(Position& position, int distanceFromRoot, const SearchData& locals, Move hashMove, bool loudOnly);	//loudOnly: just the captures and queen promotions that don't lose material, for quiescence
+
+	bool Next(Move& move);				//returns false when there are no moves left
+
+private:
+	bool PickBest(MoveList& list, Move& move);		//the highest orderScore from current onwards, or false if there are none left
+	void ScoreLoudMoves();
+	void ScoreQuietMoves();
+	void ScoreEvasions();
+	bool IsKiller(const Move& move) const;
+
+	Position& position;
+	const SearchData& locals;
+	int distanceFromRoot;
+	Move hashMove;
+	bool loudOnly;
+
+	int stage;
+	size_t current;
+
+	MoveList moves;
+	MoveList badLoud;				//losing captures and underpromotions
+};
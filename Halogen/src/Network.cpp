@@ -1,200 +1,612 @@
 #include "Network.h"
 
-static const char* WeightsTXT[] = {
-    #include "epoch1500_b8192_quant128.nn"
-    ""
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+The default network is compiled in as the bytes of its binary file, generated with 'convertnet'
+*/
+alignas(NETWORK_ALIGNMENT) static const unsigned char DefaultNetwork[] = {
+    #include "epoch1500_b8192_quant128.nnue.inc"
 };
 
-Network InitNetwork()
+static NetworkWeights weights;                                                                                  //shared by every Network, and only written to while nothing is being evaluated
+static uint64_t networkHash = 0;
+
+bool IsCompatible(const NetworkFileHeader& header, size_t fileSize);
+size_t NetworkFileSize(const std::vector<uint32_t>& layerSizes);
+size_t AlignSection(size_t offset);
+void CopyWeights(const unsigned char* file);
+size_t ReadSection(int16_t* destination, const unsigned char* file, size_t offset, size_t count);                //returns the offset of the next section
+void WriteSection(std::vector<char>& file, size_t offset, const std::vector<int16_t>& values);
+
+bool LoadDefaultNetwork()
 {
-    std::stringstream stream;
+    NetworkFileHeader header;
+    std::memcpy(&header, DefaultNetwork, sizeof(header));
 
-    for (int i = 0; strcmp(WeightsTXT[i], ""); i++)
-        stream << WeightsTXT[i] << "\n";
+    if (!IsCompatible(header, sizeof(DefaultNetwork)))
+        return false;
 
-    std::string line;
+    CopyWeights(DefaultNetwork);
+    return true;
+}
+
+bool LoadNetwork(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file)
+        return false;
+
+    size_t fileSize = file.tellg();
+    NetworkFileHeader header;
+
+    file.seekg(0);
+    if (fileSize < NETWORK_FILE_HEADER_SIZE || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    if (!IsCompatible(header, fileSize))
+        return false;
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    void* map = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    CopyWeights(static_cast<const unsigned char*>(map));
+    munmap(map, fileSize);
+#else
+    std::vector<unsigned char> buffer(fileSize);
+
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), fileSize))
+        return false;
+
+    CopyWeights(buffer.data());
+#endif
+
+    return true;
+}
+
+uint64_t NetworkHash()
+{
+    return networkHash;
+}
+
+void CopyWeights(const unsigned char* file)
+{
+    //FNV-1a over the whole file, which IsCompatible has already checked is exactly NetworkFileSize bytes long
+    size_t fileSize = NetworkFileSize(NetworkWeights::LayerSizes());
+    networkHash = 0xcbf29ce484222325;
+
+    for (size_t i = 0; i < fileSize; i++)
+        networkHash = (networkHash ^ file[i]) * 0x100000001b3;
+
+    weights.layers.Load(file, weights.hiddenLayer.Load(file, NETWORK_FILE_HEADER_SIZE));
+    weights.layers.Quantize();
+}
+
+bool ConvertNetwork(const std::string& textPath, const std::string& binaryPath, const std::string& includePath)
+{
+    /*
+    The text format is a list of quoted lines so that it can be #included as an array of strings:
+    "InputNeurons N", then "HiddenLayerNeurons M" followed by M lines of N weights and a bias, then "OutputLayer" and a line of M weights and a bias
+    */
 
-    std::vector<std::vector<int16_t>> weights;
-    std::vector<size_t> LayerNeurons;
-    weights.push_back({});
+    std::ifstream text(textPath);
 
-    while (getline(stream, line))
+    if (!text)
+        return false;
+
+    std::vector<uint32_t> layerSizes;
+    std::vector<std::vector<int16_t>> lines;                                                                    //the weights and bias of each neuron in turn
+    std::string line;
+
+    while (getline(text, line))
     {
+        line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return c == '"' || c == ','; }), line.end());
+
         std::istringstream iss(line);
         std::string token;
+        uint32_t size = 0;
 
-        iss >> token;
+        if (!(iss >> token))
+            continue;
 
-        if (token == "InputNeurons")
+        if (token == "InputNeurons" || token == "HiddenLayerNeurons")
         {
-            iss >> token;
-            LayerNeurons.push_back(stoull(token));
+            iss >> size;
+            layerSizes.push_back(size);
         }
-
-        if (token == "HiddenLayerNeurons")
+        else if (token == "OutputLayer")
+            layerSizes.push_back(1);                                                                            //always 1 output neuron
+        else
         {
-            std::vector<int16_t> layerWeights;
+            std::vector<int16_t> values;
+            values.push_back(static_cast<int16_t>(stoi(token)));
+
+            while (iss >> token)
+                values.push_back(static_cast<int16_t>(stoi(token)));
 
-            iss >> token;
-            size_t num = stoull(token);
+            lines.push_back(values);
+        }
+    }
 
-            LayerNeurons.push_back(num);
+    if (layerSizes.size() < 3 || layerSizes.size() > MAX_NETWORK_LAYERS || layerSizes.back() != 1)
+        return false;
 
-            for (size_t i = 0; i < num; i++)
-            {
-                getline(stream, line);
-                std::istringstream lineStream(line);
+    NetworkFileHeader header = {};
+    std::memcpy(header.magic, NETWORK_FILE_MAGIC, sizeof(header.magic));
+    header.version = NETWORK_FILE_VERSION;
+    header.layerCount = static_cast<uint32_t>(layerSizes.size());
+    std::copy(layerSizes.begin(), layerSizes.end(), header.layerSizes);
 
-                while (lineStream >> token)
-                {
-                    layerWeights.push_back(stoull(token));
-                }
-            }
+    std::vector<char> file(NetworkFileSize(layerSizes), 0);
+    std::memcpy(file.data(), &header, sizeof(header));
 
-            weights.push_back(layerWeights);
-        }
+    size_t offset = NETWORK_FILE_HEADER_SIZE;
+    size_t neuron = 0;
 
-        else if (token == "OutputLayer")
+    for (size_t layer = 1; layer < layerSizes.size(); layer++)
+    {
+        size_t inputs = layerSizes[layer - 1];
+        size_t outputs = layerSizes[layer];
+        std::vector<int16_t> layerWeights(inputs * outputs);
+        std::vector<int16_t> layerBias(outputs);
+
+        for (size_t j = 0; j < outputs; j++, neuron++)
         {
-            LayerNeurons.push_back(1);  //always 1 output neuron
-            std::vector<int16_t> layerWeights;
-            getline(stream, line);
-            std::istringstream lineStream(line);
-            while (lineStream >> token)
+            if (neuron >= lines.size() || lines[neuron].size() != inputs + 1)
+                return false;
+
+            for (size_t i = 0; i < inputs; i++)
             {
-                layerWeights.push_back(stoull(token));
+                if (layer == 1)
+                    layerWeights[i * outputs + j] = lines[neuron][i];
+                else
+                    layerWeights[j * inputs + i] = lines[neuron][i];
             }
-            weights.push_back(layerWeights);
+
+            layerBias[j] = lines[neuron][inputs];
         }
+
+        WriteSection(file, offset, layerWeights);
+        offset = AlignSection(offset + layerWeights.size() * sizeof(int16_t));
+        WriteSection(file, offset, layerBias);
+        offset = AlignSection(offset + layerBias.size() * sizeof(int16_t));
+    }
+
+    if (neuron != lines.size())
+        return false;
+
+    std::ofstream binary(binaryPath, std::ios::binary);
+    binary.write(file.data(), file.size());
+
+    if (!binary.good())
+        return false;
+
+    if (includePath.empty())
+        return true;
+
+    std::ofstream include(includePath);
+
+    for (size_t i = 0; i < file.size(); i++)
+    {
+        include << static_cast<unsigned int>(static_cast<unsigned char>(file[i])) << ",";
+
+        if (i % 32 == 31)
+            include << "\n";
     }
 
-    return Network(weights);
+    return include.good();
+}
+
+bool IsCompatible(const NetworkFileHeader& header, size_t fileSize)
+{
+    std::vector<uint32_t> layerSizes = NetworkWeights::LayerSizes();
+
+    return std::memcmp(header.magic, NETWORK_FILE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == NETWORK_FILE_VERSION
+        && header.layerCount == layerSizes.size()
+        && std::equal(layerSizes.begin(), layerSizes.end(), header.layerSizes)
+        && NetworkFileSize(layerSizes) == fileSize;
+}
+
+size_t NetworkFileSize(const std::vector<uint32_t>& layerSizes)
+{
+    size_t size = NETWORK_FILE_HEADER_SIZE;
+
+    for (size_t layer = 1; layer < layerSizes.size(); layer++)
+    {
+        size = AlignSection(size + sizeof(int16_t) * layerSizes[layer - 1] * layerSizes[layer]);
+        size = AlignSection(size + sizeof(int16_t) * layerSizes[layer]);
+    }
+
+    return size;
+}
+
+size_t AlignSection(size_t offset)
+{
+    return (offset + NETWORK_ALIGNMENT - 1) / NETWORK_ALIGNMENT * NETWORK_ALIGNMENT;
+}
+
+size_t ReadSection(int16_t* destination, const unsigned char* file, size_t offset, size_t count)
+{
+    //the file is little endian, as are all the targets we build for
+    std::memcpy(destination, file + offset, count * sizeof(int16_t));
+    return AlignSection(offset + count * sizeof(int16_t));
+}
+
+void WriteSection(std::vector<char>& file, size_t offset, const std::vector<int16_t>& values)
+{
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        uint16_t value = static_cast<uint16_t>(values[i]);
+        file[offset + 2 * i] = static_cast<char>(value & 0xFF);
+        file[offset + 2 * i + 1] = static_cast<char>(value >> 8);
+    }
 }
 
 template<size_t INPUT_COUNT>
-Neuron<INPUT_COUNT>::Neuron() : weights(),  bias(0)
+int32_t Neuron<INPUT_COUNT>::FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const
 {
+    int32_t ret = bias * PRECISION + DotProduct(input.data(), weights.data(), INPUT_COUNT);
+
+    return (ret + HALF_PRECISION) / PRECISION;
+}
+
+template<size_t INPUT_COUNT>
+int32_t Neuron<INPUT_COUNT>::FeedForward(const std::array<uint8_t, INPUT_COUNT>& input) const
+{
+    //the dot product comes out (INT8_ACTIVATION_SHIFT + quantizedShift) bits smaller than the int16 one, and can be too big for an int32 once scaled back up
+    int64_t ret = int64_t(bias) * PRECISION + (int64_t(DotProductInt8(input.data(), quantizedWeights.data(), INPUT_COUNT)) << (INT8_ACTIVATION_SHIFT + quantizedShift));
+
+    return static_cast<int32_t>((ret + HALF_PRECISION) / PRECISION);
 }
 
 template<size_t INPUT_COUNT>
-Neuron<INPUT_COUNT>::Neuron(std::vector<int16_t> Weight, int16_t Bias) : weights(), bias(Bias)
+void Neuron<INPUT_COUNT>::Quantize()
 {
-    assert(Weight.size() == INPUT_COUNT);
+    int largest = 0;
+
+    for (size_t i = 0; i < INPUT_COUNT; i++)
+        largest = std::max(largest, std::abs(static_cast<int>(weights[i])));
+
+    quantizedShift = 0;
+
+    while (((largest + ((1 << quantizedShift) >> 1)) >> quantizedShift) > 127)
+        quantizedShift++;
 
     for (size_t i = 0; i < INPUT_COUNT; i++)
     {
-        weights[i] = Weight[i];
+        int round = (1 << quantizedShift) >> 1;
+        int value = weights[i] >= 0 ? (weights[i] + round) >> quantizedShift : -((-weights[i] + round) >> quantizedShift);
+        quantizedWeights[i] = static_cast<int8_t>(value);
     }
 }
 
-template<size_t INPUT_COUNT>
-int32_t Neuron<INPUT_COUNT>::FeedForward(std::array<int16_t, INPUT_COUNT>& input) const
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+void HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::FeedForward(std::array<int16_t, OUTPUT_COUNT>& zeta, const std::array<int16_t, INPUT_COUNT>& input) const
 {
-    int32_t ret = bias * PRECISION;
+    zeta = bias;
 
     for (size_t i = 0; i < INPUT_COUNT; i++)
     {
-        ret += input[i] * weights[i];
+        assert(input[i] == 0 || input[i] == PRECISION);
+
+        if (input[i] != 0)
+            AddWeights(zeta.data(), weights.data() + i * OUTPUT_COUNT, OUTPUT_COUNT);
     }
 
-    return (ret + HALF_PRECISION) / PRECISION;
+    /*
+    This used to be a dot product with the inputs scaled by PRECISION, rounded with (x + HALF_PRECISION) / PRECISION. Integer division rounds 
+    towards zero, so that rounded every negative sum up by one. Keep doing so, so that the evaluation is unchanged
+    */
+    for (size_t j = 0; j < OUTPUT_COUNT; j++)
+    {
+        if (zeta[j] < 0)
+            zeta[j]++;
+    }
 }
 
 template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
-HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::HiddenLayer(std::vector<int16_t> inputs) : neurons(new std::array<Neuron<INPUT_COUNT>, OUTPUT_COUNT>), weightTranspose(new std::array<int16_t, INPUT_COUNT* OUTPUT_COUNT>)
+void HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::ApplyDelta(std::array<int16_t, OUTPUT_COUNT>& zeta, const deltaArray& deltaVec) const
 {
-    assert(inputs.size() % OUTPUT_COUNT == 0);
+    for (size_t point = 0; point < deltaVec.size; point++)
+    {
+        int16_t deltaValue = deltaVec.deltas[point].delta; 
+        const int16_t* column = weights.data() + deltaVec.deltas[point].index * OUTPUT_COUNT;
 
-    size_t WeightsPerNeuron = inputs.size() / OUTPUT_COUNT;
+        if (deltaValue == 1)
+            AddWeights(zeta.data(), column, OUTPUT_COUNT);
 
-    for (size_t i = 0; i < OUTPUT_COUNT; i++)
-    {
-        (*neurons)[i] = Neuron<INPUT_COUNT>(std::vector<int16_t>(inputs.begin() + (WeightsPerNeuron * i), inputs.begin() + (WeightsPerNeuron * i) + WeightsPerNeuron - 1), inputs.at(WeightsPerNeuron * (1 + i) - 1));
+        if (deltaValue == -1)
+            SubWeights(zeta.data(), column, OUTPUT_COUNT);
     }
+}
 
-    for (size_t i = 0; i < WeightsPerNeuron - 1; i++)
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+void HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::FeedForwardBatch(std::array<int16_t, OUTPUT_COUNT>* zeta, const NetworkInput* inputs, size_t count) const
+{
+    for (size_t i = 0; i < count; i++)
     {
+        zeta[i] = bias;
+
+        for (size_t j = 0; j < inputs[i].count; j++)
+        {
+            assert(inputs[i].active[j] < INPUT_COUNT);
+            AddWeights(zeta[i].data(), weights.data() + inputs[i].active[j] * OUTPUT_COUNT, OUTPUT_COUNT);
+        }
+
         for (size_t j = 0; j < OUTPUT_COUNT; j++)
         {
-            weightTranspose->at(i * OUTPUT_COUNT + j) = (neurons->at(j).weights.at(i));
+            if (zeta[i][j] < 0)
+                zeta[i][j]++;                                                                                   //the same rounding as FeedForward
         }
     }
+}
 
-    zeta = {};
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+size_t HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::Load(const unsigned char* file, size_t offset)
+{
+    offset = ReadSection(weights.data(), file, offset, INPUT_COUNT * OUTPUT_COUNT);
+    return ReadSection(bias.data(), file, offset, OUTPUT_COUNT);
 }
 
 template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
-std::array<int16_t, OUTPUT_COUNT> HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::FeedForward(std::array<int16_t, INPUT_COUNT>& input)
+template<typename T>
+void DenseLayer<INPUT_COUNT, OUTPUT_COUNT>::FeedForward(const std::array<T, INPUT_COUNT>& input, std::array<int32_t, OUTPUT_COUNT>& output) const
 {
-    for (size_t i = 0; i < neurons->size(); i++)
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
     {
-        zeta[i] = neurons->at(i).FeedForward(input);
+        output[i] = neurons[i].FeedForward(input);
     }
-
-    return zeta;
 }
 
 template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
-void HiddenLayer<INPUT_COUNT, OUTPUT_COUNT>::ApplyDelta(deltaArray& deltaVec)
+void DenseLayer<INPUT_COUNT, OUTPUT_COUNT>::FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, std::array<int32_t, OUTPUT_COUNT>* output, size_t count) const
 {
-    for (size_t point = 0; point < deltaVec.size; point++)
+    assert(count <= NETWORK_BATCH_SIZE);
+
+#ifdef USE_INT8_NETWORK
+    std::array<std::array<uint8_t, INPUT_COUNT>, NETWORK_BATCH_SIZE> packed;
+
+    for (size_t j = 0; j < count; j++)
     {
-        int16_t deltaValue = deltaVec.deltas[point].delta; 
-        size_t weightTransposeIndex = deltaVec.deltas[point].index * OUTPUT_COUNT;
+        PackActivations(packed[j].data(), input[j].data(), INPUT_COUNT, INT8_ACTIVATION_SHIFT);
+    }
+#else
+    const std::array<int16_t, INPUT_COUNT>* packed = input;
+#endif
 
-        if (deltaValue == 1)
+    //neuron by neuron over the whole batch, so each neurons weights stay in cache while they are used
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
+    {
+        for (size_t j = 0; j < count; j++)
         {
-            for (size_t neuron = 0; neuron < OUTPUT_COUNT; neuron++)
-            {
-                zeta[neuron] += (*weightTranspose)[weightTransposeIndex + neuron];
-            }
+            output[j][i] = neurons[i].FeedForward(packed[j]);
         }
+    }
+}
 
-        if (deltaValue == -1)
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+size_t DenseLayer<INPUT_COUNT, OUTPUT_COUNT>::Load(const unsigned char* file, size_t offset)
+{
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
+    {
+        ReadSection(neurons[i].weights.data(), file, offset + i * INPUT_COUNT * sizeof(int16_t), INPUT_COUNT);
+    }
+
+    offset = AlignSection(offset + OUTPUT_COUNT * INPUT_COUNT * sizeof(int16_t));
+
+    std::array<int16_t, OUTPUT_COUNT> bias;
+    offset = ReadSection(bias.data(), file, offset, OUTPUT_COUNT);
+
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
+    {
+        neurons[i].bias = bias[i];
+    }
+
+    return offset;
+}
+
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+void DenseLayer<INPUT_COUNT, OUTPUT_COUNT>::Quantize()
+{
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
+    {
+        neurons[i].Quantize();
+    }
+}
+
+template<size_t INPUT_COUNT>
+int32_t LayerStack<INPUT_COUNT, 1>::FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const
+{
+    std::array<int32_t, 1> output;
+    layer.FeedForward(input, output);
+    return output[0];
+}
+
+template<size_t INPUT_COUNT>
+int32_t LayerStack<INPUT_COUNT, 1>::FeedForwardInt8(const std::array<int16_t, INPUT_COUNT>& input) const
+{
+    std::array<uint8_t, INPUT_COUNT> packed;
+    PackActivations(packed.data(), input.data(), INPUT_COUNT, INT8_ACTIVATION_SHIFT);
+
+    std::array<int32_t, 1> output;
+    layer.FeedForward(packed, output);
+    return output[0];
+}
+
+template<size_t INPUT_COUNT>
+void LayerStack<INPUT_COUNT, 1>::FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, int32_t* output, size_t count) const
+{
+    std::array<std::array<int32_t, 1>, NETWORK_BATCH_SIZE> outputs;
+    layer.FeedForwardBatch(input, outputs.data(), count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        output[i] = outputs[i][0];
+    }
+}
+
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT, size_t... NEXT_SIZES>
+void LayerStack<INPUT_COUNT, OUTPUT_COUNT, NEXT_SIZES...>::FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, int32_t* output, size_t count) const
+{
+    std::array<std::array<int32_t, OUTPUT_COUNT>, NETWORK_BATCH_SIZE> outputs;
+    layer.FeedForwardBatch(input, outputs.data(), count);
+
+    std::array<std::array<int16_t, OUTPUT_COUNT>, NETWORK_BATCH_SIZE> activations;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < OUTPUT_COUNT; j++)
         {
-            for (size_t neuron = 0; neuron < OUTPUT_COUNT; neuron++)
-            {
-                zeta[neuron] -= (*weightTranspose)[weightTransposeIndex + neuron];
-            }
+            activations[i][j] = static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(outputs[i][j], 0), std::numeric_limits<int16_t>::max()));
         }
     }
+
+    next.FeedForwardBatch(activations.data(), output, count);
 }
 
-Network::Network(const std::vector<std::vector<int16_t>>& inputs) : hiddenLayer(inputs[1]), outputNeuron(std::vector<int16_t>(inputs.back().begin(), inputs.back().end() - 1), inputs.back().back()), OldZeta()
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT, size_t... NEXT_SIZES>
+int32_t LayerStack<INPUT_COUNT, OUTPUT_COUNT, NEXT_SIZES...>::FeedForwardInt8(const std::array<int16_t, INPUT_COUNT>& input) const
 {
+    std::array<uint8_t, INPUT_COUNT> packed;
+    PackActivations(packed.data(), input.data(), INPUT_COUNT, INT8_ACTIVATION_SHIFT);
+
+    std::array<int32_t, OUTPUT_COUNT> output;
+    layer.FeedForward(packed, output);
+
+    std::array<int16_t, OUTPUT_COUNT> activation;
+
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
+    {
+        activation[i] = static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(output[i], 0), std::numeric_limits<int16_t>::max()));
+    }
+
+    return next.FeedForwardInt8(activation);
 }
 
-void Network::RecalculateIncremental(std::array<int16_t, INPUT_NEURONS> inputs)
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT, size_t... NEXT_SIZES>
+int32_t LayerStack<INPUT_COUNT, OUTPUT_COUNT, NEXT_SIZES...>::FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const
 {
-    for (size_t i = 0; i < MAX_DEPTH; i++)
+    std::array<int32_t, OUTPUT_COUNT> output;
+    layer.FeedForward(input, output);
+
+    std::array<int16_t, OUTPUT_COUNT> activation;
+
+    for (size_t i = 0; i < OUTPUT_COUNT; i++)
     {
-        OldZeta[i] = {};
+        activation[i] = static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(output[i], 0), std::numeric_limits<int16_t>::max()));  //ReLU, saturating rather than wrapping
     }
-    incrementalDepth = 0;
 
-    //We never actually use FeedForward to get the evaluaton, only to 'refresh' the incremental updates and so we only need to do connection with first layer
-    hiddenLayer.FeedForward(inputs);
+    return next.FeedForward(activation);
+}
+
+Network::Network()
+{
+    accumulators[0].zeta = {};
+    accumulators[0].computed = true;
 }
 
-void Network::ApplyDelta(deltaArray& delta)
+void Network::RecalculateIncremental(std::array<int16_t, INPUT_NEURONS> inputs)
+{
+    current = 0;
+
+    //We never actually use FeedForward to get the evaluaton, only to 'refresh' the incremental updates and so we only need to do connection with first layer
+    weights.hiddenLayer.FeedForward(accumulators[0].zeta, inputs);
+    accumulators[0].computed = true;
+}
+void Network::ApplyDelta(const deltaArray& delta)
 {
-    OldZeta[incrementalDepth++] = hiddenLayer.zeta;
-    hiddenLayer.ApplyDelta(delta);
+    assert(current < MAX_DEPTH);
+
+    Accumulator& next = accumulators[++current];
+    next.delta = delta;
+    next.computed = false;
 }
 
 void Network::ApplyInverseDelta()
 {
-    hiddenLayer.zeta = OldZeta[--incrementalDepth];
+    assert(current > 0);
+    current--;
 }
 
-int16_t Network::QuickEval()
+void Network::MaterializeAccumulator()
 {
-    std::array<int16_t, HIDDEN_NEURONS> inputs;
-    
-    for (size_t i = 0; i < HIDDEN_NEURONS; i++)
+    size_t clean = current;
+
+    while (!accumulators[clean].computed)
+        clean--;                                                                                                //accumulators[0] is always computed
+
+    for (size_t i = clean + 1; i <= current; i++)
     {
-        inputs[i] = std::max(int16_t(0), hiddenLayer.zeta[i]);
+        accumulators[i].zeta = accumulators[i - 1].zeta;
+        weights.hiddenLayer.ApplyDelta(accumulators[i].zeta, accumulators[i].delta);
+        accumulators[i].computed = true;
     }
+}
+
+void EvaluateBatch(const NetworkInput* inputs, int16_t* output, size_t count)
+{
+    std::array<std::array<int16_t, HIDDEN_NEURONS>, NETWORK_BATCH_SIZE> zeta;
+    std::array<int32_t, NETWORK_BATCH_SIZE> scores;
+
+    for (size_t start = 0; start < count; start += NETWORK_BATCH_SIZE)
+    {
+        size_t size = std::min(NETWORK_BATCH_SIZE, count - start);
+
+        weights.hiddenLayer.FeedForwardBatch(zeta.data(), inputs + start, size);
+
+        for (size_t i = 0; i < size; i++)
+        {
+            ReLU(zeta[i].data(), zeta[i].data(), HIDDEN_NEURONS);
+        }
+
+        weights.layers.FeedForwardBatch(zeta.data(), scores.data(), size);
+
+        for (size_t i = 0; i < size; i++)
+        {
+            output[start + i] = static_cast<int16_t>((scores[i] + HALF_PRECISION) / PRECISION);
+        }
+    }
+}
+
+int16_t Network::QuickEval()
+{
+#ifdef USE_INT8_NETWORK
+    return QuickEvalInt8();
+#else
+    return QuickEvalInt16();
+#endif
+}
+
+int16_t Network::QuickEvalInt16()
+{
+    MaterializeAccumulator();
 
-    return (outputNeuron.FeedForward(inputs) + HALF_PRECISION) / PRECISION;
-}
\ No newline at end of file
+    std::array<int16_t, HIDDEN_NEURONS> inputs;
+    ReLU(inputs.data(), accumulators[current].zeta.data(), HIDDEN_NEURONS);
+
+    return (weights.layers.FeedForward(inputs) + HALF_PRECISION) / PRECISION;
+}
+
+int16_t Network::QuickEvalInt8()
+{
+    MaterializeAccumulator();
+
+    //PackActivations clamps at zero, so there is no need for a separate ReLU
+    return (weights.layers.FeedForwardInt8(accumulators[current].zeta) + HALF_PRECISION) / PRECISION;
+}
@@ -12,14 +12,40 @@
 #include <cstring>
 #include "EvalCache.h"
 #include "BitBoardDefine.h"
+#include "NetworkKernels.h"
 
 constexpr size_t INPUT_NEURONS = 12 * 64;
 constexpr size_t HIDDEN_NEURONS = 128;
+constexpr size_t NETWORK_ALIGNMENT = 64;                                                                        //for the weights in memory and the sections in a network file
 
 constexpr int16_t MAX_VALUE = 128;
 constexpr int16_t PRECISION = ((size_t)std::numeric_limits<int16_t>::max() + 1) / MAX_VALUE;
 constexpr int16_t HALF_PRECISION = PRECISION / 2;
 
+/*
+The int8 path (used when built with USE_INT8_NETWORK) packs the activations after the first layer to uint8 in [0, 127] by shifting them 
+down INT8_ACTIVATION_SHIFT bits, and each neurons weights to int8 with their own shift chosen when the network is loaded. 
+The int16 path is the reference and stays the default until a network is trained with this quantization in mind, see 'netcheck'.
+*/
+constexpr int INT8_ACTIVATION_SHIFT = 7;
+
+static_assert(HIDDEN_NEURONS % 16 == 0, "the vector kernels work on blocks of 16 neurons");
+static_assert(INPUT_NEURONS % 16 == 0, "the vector kernels work on blocks of 16 inputs");
+
+/*
+For scoring many positions at once away from the search. Each position is just the list of its active inputs, and they are evaluated
+NETWORK_BATCH_SIZE at a time, with every layer after the first worked out one neuron at a time for the whole batch so that each 
+weight is only loaded once per batch rather than once per position
+*/
+constexpr size_t NETWORK_BATCH_SIZE = 64;
+constexpr size_t MAX_ACTIVE_INPUTS = 32;                                                                        //one per piece
+
+struct NetworkInput
+{
+    std::array<uint16_t, MAX_ACTIVE_INPUTS> active;                                                            //indexes of the inputs set to PRECISION, all others are 0
+    size_t count = 0;
+};
+
 struct deltaArray
 {
     struct deltaPoint
@@ -32,49 +58,147 @@ struct deltaArray
     deltaPoint deltas[4];
 };
 
+/*
+The weights are loaded once into a single read only NetworkWeights shared by every thread. Each Network only holds its own accumulators.
+
+The first layer is updated incrementally as moves are made. Every layer after it is a DenseLayer fed with the ReLU of the layer before, 
+and the last layer must have a single neuron. All the sizes are template paramiters so every loop has a compile time length.
+*/
 template<size_t INPUT_COUNT>
 struct Neuron
 {
-    Neuron();
-    Neuron(std::vector<int16_t> Weight, int16_t Bias);
-    int32_t FeedForward(std::array<int16_t, INPUT_COUNT>& input) const;
+    int32_t FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const;
+    int32_t FeedForward(const std::array<uint8_t, INPUT_COUNT>& input) const;                                  //input is the activations packed with PackActivations
+    void Quantize();                                                                                            //fills in the int8 weights from the int16 ones
 
-    std::array<int16_t, INPUT_COUNT> weights;
+    alignas(NETWORK_ALIGNMENT) std::array<int16_t, INPUT_COUNT> weights;
+    alignas(NETWORK_ALIGNMENT) std::array<int8_t, INPUT_COUNT> quantizedWeights;                              //weights >> quantizedShift
+    int quantizedShift;
     int16_t bias;
 };
 
 template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
 struct HiddenLayer
 {
-    HiddenLayer(std::vector<int16_t> inputs);                                                                   // <for first neuron>: weight1, weight2, ..., weightN, bias, <next neuron etc...>
-    std::array<int16_t, OUTPUT_COUNT> FeedForward(std::array<int16_t, INPUT_COUNT>& input);
+    void FeedForward(std::array<int16_t, OUTPUT_COUNT>& zeta, const std::array<int16_t, INPUT_COUNT>& input) const;    //input values must be 0 or PRECISION
+    void ApplyDelta(std::array<int16_t, OUTPUT_COUNT>& zeta, const deltaArray& deltaVec) const;                 //incrementally update the connections between input layer and first hidden layer
+    void FeedForwardBatch(std::array<int16_t, OUTPUT_COUNT>* zeta, const NetworkInput* inputs, size_t count) const;
+    size_t Load(const unsigned char* file, size_t offset);                                                      //returns the offset of the next layer
 
-    void ApplyDelta(deltaArray& deltaVec);                                                         //incrementally update the connections between input layer and first hidden layer
+    alignas(NETWORK_ALIGNMENT) std::array<int16_t, INPUT_COUNT * OUTPUT_COUNT> weights;                          //input major: every neurons weight for the first input, then the second input etc...
+    alignas(NETWORK_ALIGNMENT) std::array<int16_t, OUTPUT_COUNT> bias;
+};
 
-    std::array<Neuron<INPUT_COUNT>, OUTPUT_COUNT>* neurons;
-    std::array<int16_t, OUTPUT_COUNT> zeta;
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT>
+struct DenseLayer
+{
+    static_assert(INPUT_COUNT % 16 == 0, "the vector kernels work on blocks of 16 inputs");
 
-private:
-    std::array<int16_t, INPUT_COUNT * OUTPUT_COUNT>* weightTranspose;                                                                       //first neuron first weight, second neuron first weight etc...
+    static_assert(INPUT_COUNT % 32 == 0, "the int8 kernels work on blocks of 32 inputs");
+
+    template<typename T>
+    void FeedForward(const std::array<T, INPUT_COUNT>& input, std::array<int32_t, OUTPUT_COUNT>& output) const;
+    void FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, std::array<int32_t, OUTPUT_COUNT>* output, size_t count) const; //count is at most NETWORK_BATCH_SIZE
+    size_t Load(const unsigned char* file, size_t offset);
+    void Quantize();
+
+    std::array<Neuron<INPUT_COUNT>, OUTPUT_COUNT> neurons;
+};
+
+template<size_t... LAYER_SIZES>
+struct LayerStack;                                                                                              //the dense layers, each one feeding the next
+
+template<size_t INPUT_COUNT>
+struct LayerStack<INPUT_COUNT, 1>
+{
+    int32_t FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const;
+    int32_t FeedForwardInt8(const std::array<int16_t, INPUT_COUNT>& input) const;
+    void FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, int32_t* output, size_t count) const;
+    size_t Load(const unsigned char* file, size_t offset) { return layer.Load(file, offset); }
+    void Quantize() { layer.Quantize(); }
+
+    DenseLayer<INPUT_COUNT, 1> layer;
+};
+
+template<size_t INPUT_COUNT, size_t OUTPUT_COUNT, size_t... NEXT_SIZES>
+struct LayerStack<INPUT_COUNT, OUTPUT_COUNT, NEXT_SIZES...>
+{
+    static_assert(OUTPUT_COUNT % 16 == 0, "the vector kernels work on blocks of 16 neurons");
+
+    int32_t FeedForward(const std::array<int16_t, INPUT_COUNT>& input) const;
+    int32_t FeedForwardInt8(const std::array<int16_t, INPUT_COUNT>& input) const;
+    void FeedForwardBatch(const std::array<int16_t, INPUT_COUNT>* input, int32_t* output, size_t count) const;
+    size_t Load(const unsigned char* file, size_t offset) { return next.Load(file, layer.Load(file, offset)); }
+    void Quantize() { layer.Quantize(); next.Quantize(); }
+
+    DenseLayer<INPUT_COUNT, OUTPUT_COUNT> layer;
+    LayerStack<OUTPUT_COUNT, NEXT_SIZES...> next;
+};
+
+template<size_t INPUT_COUNT, size_t HIDDEN_COUNT, size_t... DENSE_SIZES>
+struct NetworkArchitecture
+{
+    static std::vector<uint32_t> LayerSizes() { return { INPUT_COUNT, HIDDEN_COUNT, DENSE_SIZES... }; }
+
+    HiddenLayer<INPUT_COUNT, HIDDEN_COUNT> hiddenLayer;
+    LayerStack<HIDDEN_COUNT, DENSE_SIZES...> layers;
+};
+
+using NetworkWeights = NetworkArchitecture<INPUT_NEURONS, HIDDEN_NEURONS, 1>;                                  //to change the architecture change the sizes here, for example <INPUT_NEURONS, HIDDEN_NEURONS, 32, 32, 1>
+
+/*
+The hidden layer values for each position along the current line, indexed by the number of moves since the last full refresh.
+Making a move only records its delta, and the values are worked out when QuickEval needs them by replaying the pending deltas on top 
+of the nearest entry that is up to date. Nodes that are pruned before being evaluated never touch the hidden layer, and unmaking a move
+is just stepping back down the stack.
+*/
+struct Accumulator
+{
+    std::array<int16_t, HIDDEN_NEURONS> zeta;
+    deltaArray delta;                                                                                           //the change from the entry below
+    bool computed;                                                                                              //is zeta up to date?
 };
 
 struct Network
 {
-    Network(const std::vector<std::vector<int16_t>>& inputs);
+    Network();
     void RecalculateIncremental(std::array<int16_t, INPUT_NEURONS> inputs);
 
-    void ApplyDelta(deltaArray& delta);                                                            //incrementally update the connections between input layer and first hidden layer
+    void ApplyDelta(const deltaArray& delta);                                                                   //incrementally update the connections between input layer and first hidden layer
     void ApplyInverseDelta();                                                                                   //for un-make moves
     int16_t QuickEval();                                                                                        //when used with above, this just calculates starting from the alpha of first hidden layer and skips input -> hidden
+    int16_t QuickEvalInt16();
+    int16_t QuickEvalInt8();
 
 private:
+    void MaterializeAccumulator();                                                                              //bring the current accumulator up to date
 
-    //hard code the number of layers here
-    HiddenLayer <INPUT_NEURONS, HIDDEN_NEURONS> hiddenLayer;
-    Neuron<HIDDEN_NEURONS> outputNeuron;
+    std::array<Accumulator, MAX_DEPTH + 1> accumulators;
+    size_t current = 0;
+};
 
-    std::array<std::array<int16_t, HIDDEN_NEURONS>, MAX_DEPTH>  OldZeta;
-    size_t incrementalDepth = 0;
+/*
+Binary network file: a NetworkFileHeader padded out to NETWORK_FILE_HEADER_SIZE, followed by little endian int16 sections that each start
+on a NETWORK_ALIGNMENT boundary. For each layer there are the weights and then the biases. The first layers weights are input major, 
+so that each inputs column of weights is contiguous, and every other layers weights are neuron major.
+*/
+constexpr char NETWORK_FILE_MAGIC[8] = { 'H', 'A', 'L', 'O', 'N', 'N', 'U', 'E' };
+constexpr uint32_t NETWORK_FILE_VERSION = 2;
+constexpr size_t NETWORK_FILE_HEADER_SIZE = 64;
+constexpr size_t MAX_NETWORK_LAYERS = 12;                                                                       //counting the inputs as a layer
+
+struct NetworkFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t layerCount;
+    uint32_t layerSizes[MAX_NETWORK_LAYERS];
 };
 
-Network InitNetwork();
\ No newline at end of file
+static_assert(sizeof(NetworkFileHeader) <= NETWORK_FILE_HEADER_SIZE, "NetworkFileHeader must fit in the padded header");
+
+bool LoadDefaultNetwork();                                                                                      //must be called before any Position is evaluated. Returns false if the embedded network doesn't match NetworkWeights
+bool LoadNetwork(const std::string& path);                                                                      //returns false and keeps the current network if the file is missing or doesn't match NetworkWeights
+uint64_t NetworkHash();                                                                                         //a hash of the bytes of the loaded network file, so saved scores can be tied to the network that gave them
+void EvaluateBatch(const NetworkInput* inputs, int16_t* output, size_t count);                                  //any count, gives the same scores as QuickEval would for each position
+bool ConvertNetwork(const std::string& textPath, const std::string& binaryPath, const std::string& includePath = "");    //from the old text format, with any layer sizes. Optionally also writes the bytes as an #include for embedding
\ No newline at end of file
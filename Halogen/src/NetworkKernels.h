@@ -0,0 +1,216 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(USE_AVX2)
+#include <immintrin.h>
+#define NETWORK_AVX2
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#include <tmmintrin.h>
+#define NETWORK_SSE4
+#endif
+
+/*
+The vector kernels used by the network. Every length passed in must be a multiple of 16 (32 for the int8 kernels), and the int16 lanes
+wrap on overflow exactly as the scalar loops do, so all three versions give identical results. The pointers don't need to be aligned.
+*/
+
+#if defined(NETWORK_AVX2)
+constexpr const char* NETWORK_KERNELS = "avx2";
+#elif defined(NETWORK_SSE4)
+constexpr const char* NETWORK_KERNELS = "sse4.1";
+#else
+constexpr const char* NETWORK_KERNELS = "scalar";
+#endif
+
+inline void AddWeights(int16_t* accumulator, const int16_t* weights, size_t count)
+{
+#if defined(NETWORK_AVX2)
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+		__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(accumulator + i), _mm256_add_epi16(acc, w));
+	}
+#elif defined(NETWORK_SSE4)
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+		__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i), _mm_add_epi16(acc, w));
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		accumulator[i] += weights[i];
+#endif
+}
+
+inline void SubWeights(int16_t* accumulator, const int16_t* weights, size_t count)
+{
+#if defined(NETWORK_AVX2)
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+		__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(accumulator + i), _mm256_sub_epi16(acc, w));
+	}
+#elif defined(NETWORK_SSE4)
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+		__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i), _mm_sub_epi16(acc, w));
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		accumulator[i] -= weights[i];
+#endif
+}
+
+inline void ReLU(int16_t* output, const int16_t* input, size_t count)
+{
+#if defined(NETWORK_AVX2)
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_max_epi16(x, zero));
+	}
+#elif defined(NETWORK_SSE4)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_max_epi16(x, zero));
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		output[i] = input[i] > 0 ? input[i] : 0;
+#endif
+}
+
+inline int32_t DotProduct(const int16_t* a, const int16_t* b, size_t count)
+{
+#if defined(NETWORK_AVX2)
+	__m256i sum = _mm256_setzero_si256();
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));		//multiply int16 pairs and add adjacent products into int32
+	}
+
+	__m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum128);
+#elif defined(NETWORK_SSE4)
+	__m128i sum = _mm_setzero_si128();
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(x, y));
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+#else
+	int32_t sum = 0;
+
+	for (size_t i = 0; i < count; i++)
+		sum += a[i] * b[i];
+
+	return sum;
+#endif
+}
+
+inline void PackActivations(uint8_t* output, const int16_t* input, size_t count, int shift)	//output = clamp(round(input >> shift), 0, 127)
+{
+	const int16_t round = static_cast<int16_t>((1 << shift) >> 1);
+
+#if defined(NETWORK_AVX2)
+	const __m256i rounding = _mm256_set1_epi16(round);
+	const __m256i maximum = _mm256_set1_epi8(127);
+
+	for (size_t i = 0; i < count; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 16));
+		a = _mm256_srai_epi16(_mm256_adds_epi16(a, rounding), shift);
+		b = _mm256_srai_epi16(_mm256_adds_epi16(b, rounding), shift);
+
+		__m256i packed = _mm256_packus_epi16(a, b);										//packs within each 128 bit lane...
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));				//...so put the lanes back in order
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_min_epu8(packed, maximum));
+	}
+#elif defined(NETWORK_SSE4)
+	const __m128i rounding = _mm_set1_epi16(round);
+	const __m128i maximum = _mm_set1_epi8(127);
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+		a = _mm_srai_epi16(_mm_adds_epi16(a, rounding), shift);
+		b = _mm_srai_epi16(_mm_adds_epi16(b, rounding), shift);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_min_epu8(_mm_packus_epi16(a, b), maximum));
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		int value = std::min(static_cast<int>(input[i]) + round, 32767) >> shift;				//matches the saturating add above
+		output[i] = static_cast<uint8_t>(std::min(127, std::max(0, value)));
+	}
+#endif
+}
+
+inline int32_t DotProductInt8(const uint8_t* a, const int8_t* b, size_t count)
+{
+	//a is at most 127 so the pairs maddubs adds together can't saturate
+#if defined(NETWORK_AVX2)
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+
+	for (size_t i = 0; i < count; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		__m256i products = _mm256_maddubs_epi16(x, y);									//multiply uint8 by int8 and add adjacent pairs into int16
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));					//then add adjacent int16 into int32
+	}
+
+	__m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum128);
+#elif defined(NETWORK_SSE4)
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sum = _mm_setzero_si128();
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, y), ones));
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+#else
+	int32_t sum = 0;
+
+	for (size_t i = 0; i < count; i++)
+		sum += a[i] * b[i];
+
+	return sum;
+#endif
+}
@@ -1,8 +1,9 @@
 #include "Position.h"
 
-Position::Position() : net(InitNetwork())
+Position::Position()
 {
-	key = EMPTY;
+	states.resize(STATE_STACK_SIZE);
+	ply = 0;
 	StartingPosition();
 }
 
@@ -13,9 +14,15 @@ Position::~Position()
 
 void Position::ApplyMove(Move move)
 {
-	PreviousKeys.push_back(key);
-	SaveParamiters();
-	SaveBoard();
+	assert(ply + 1 < states.size());
+
+	PositionState& next = states[ply + 1];
+	next.key = states[ply].key;
+	next.move = move;
+	next.captured = GetSquare(move.GetTo());
+	next.previousParamiters = static_cast<const BoardParamiterData&>(*this);
+	ply++;
+
 	SetEnPassant(static_cast<unsigned int>(-1));
 	Increment50Move();
 
@@ -91,9 +98,10 @@ void Position::ApplyMove(Move move)
 	UpdateCastleRights(move);
 	IncrementZobristKey(move);
 	net.ApplyDelta(CalculateMoveDelta(move));
+	UpdateCheckInfo();
 	nodesSearched++;
 
-	/*if (GenerateZobristKey() != key)
+	/*if (GenerateZobristKey() != GetZobristKey())
 	{
 		std::cout << "error";
 		NextTurn();	//just adding something here to really mess things up
@@ -112,6 +120,22 @@ void Position::ApplyMove(Move move)
 }
 
 void Position::ApplyMove(std::string strmove)
+{
+	ApplyGameMove(strmove);
+	net.RecalculateIncremental(GetInputLayer());
+}
+
+void Position::ApplyMoves(const std::vector<std::string>& strmoves)
+{
+	for (size_t i = 0; i < strmoves.size(); i++)
+	{
+		ApplyGameMove(strmoves[i]);
+	}
+
+	net.RecalculateIncremental(GetInputLayer());
+}
+
+void Position::ApplyGameMove(const std::string& strmove)
 {
 	unsigned int prev = (strmove[0] - 97) + (strmove[1] - 49) * 8;
 	unsigned int next = (strmove[2] - 97) + (strmove[3] - 49) * 8;
@@ -160,25 +184,66 @@ void Position::ApplyMove(std::string strmove)
 			flag += 4;
 	}
 
+	if (ply + MAX_DEPTH + 2 >= states.size())		//only game moves come through here, so a search never sees the stack move
+		states.resize(states.size() * 2);
+
 	ApplyMove(Move(prev, next, flag));
-	net.RecalculateIncremental(GetInputLayer());
+	net.ApplyInverseDelta();		//the accumulator stack is only for the search. The caller refreshes the whole network once it has played its moves
 }
 
 void Position::RevertMove()
 {
-	assert(PreviousKeys.size() > 0);
+	assert(ply > 0);
+
+	const PositionState& state = states[ply];
+	Move move = state.move;
+	RestoreParamiters(state.previousParamiters);	//note this puts the turn back, so GetTurn() is now the side that made the move
+
+	unsigned int from = move.GetFrom();
+	unsigned int to = move.GetTo();
+
+	if (move.IsPromotion())
+		SetSquare(from, Piece(PAWN, GetTurn()));
+	else
+		SetSquare(from, GetSquare(to));
+
+	if (state.captured != N_PIECES)
+		SetSquare(to, state.captured);
+	else
+		ClearSquare(to);
 
-	RestorePreviousBoard();
-	RestorePreviousParamiters();
-	key = PreviousKeys.back();
-	PreviousKeys.pop_back();
+	switch (move.GetFlag())
+	{
+	case EN_PASSANT:
+		SetSquare(GetPosition(GetFile(to), GetRank(from)), Piece(PAWN, !GetTurn()));
+		break;
+	case KING_CASTLE:
+		SetSquare(GetPosition(FILE_H, GetRank(from)), Piece(ROOK, GetTurn()));
+		ClearSquare(GetPosition(FILE_F, GetRank(from)));
+		break;
+	case QUEEN_CASTLE:
+		SetSquare(GetPosition(FILE_A, GetRank(from)), Piece(ROOK, GetTurn()));
+		ClearSquare(GetPosition(FILE_D, GetRank(from)));
+		break;
+	default:
+		break;
+	}
+
+	ply--;
 	net.ApplyInverseDelta();
 }
 
 void Position::ApplyNullMove()
 {
-	PreviousKeys.push_back(key);
-	SaveParamiters();
+	assert(ply + 1 < states.size());
+
+	PositionState& next = states[ply + 1];
+	next.key = states[ply].key;
+	next.move = Move();
+	next.captured = N_PIECES;
+	next.previousParamiters = static_cast<const BoardParamiterData&>(*this);
+	ply++;
+
 	SetEnPassant(static_cast<unsigned int>(-1));
 	SetCaptureSquare(static_cast<unsigned int>(-1));
 	Increment50Move();
@@ -186,8 +251,9 @@ void Position::ApplyNullMove()
 	NextTurn();
 	IncrementZobristKey(Move());
 	net.ApplyDelta(CalculateMoveDelta(Move()));
+	UpdateCheckInfo();
 
-	/*if (GenerateZobristKey() != key)
+	/*if (GenerateZobristKey() != GetZobristKey())
 	{
 		std::cout << "error";
 		NextTurn();
@@ -196,11 +262,10 @@ void Position::ApplyNullMove()
 
 void Position::RevertNullMove()
 {
-	assert(PreviousKeys.size() > 0);
+	assert(ply > 0);
 
-	RestorePreviousParamiters();
-	key = PreviousKeys.back();
-	PreviousKeys.pop_back();
+	RestoreParamiters(states[ply].previousParamiters);
+	ply--;
 	net.ApplyInverseDelta();
 }
 
@@ -255,8 +320,10 @@ bool Position::InitialiseFromFen(std::vector<std::string> fen)
 	if (!InitialiseParamitersFromFen(fen))
 		return false;
 
-	key = GenerateZobristKey();
+	ply = 0;
+	states[0].key = GenerateZobristKey();
 	net.RecalculateIncremental(GetInputLayer());
+	UpdateCheckInfo();
 
 	nodesSearched = 0;
 	tbHits = 0;
@@ -301,23 +368,116 @@ bool Position::InitialiseFromFen(std::string fen)
 
 uint64_t Position::GetZobristKey() const
 {
-	return key;
+	return states[ply].key;
 }
 
 void Position::Reset()
 {
-	PreviousKeys.clear();
-	key = EMPTY;
+	ply = 0;
+	states[0].key = EMPTY;
 	EvaluatedPositions = 0;
 
 	ResetBoard();
 	InitParamiters();
 }
 
-uint64_t Position::GetPreviousKey(size_t index)
+void Position::UpdateCheckInfo()
+{
+	CheckInfo& checkInfo = states[ply].checkInfo;
+	bool turn = GetTurn();
+	unsigned int king = GetKing(turn);
+	unsigned int enemyKing = GetKing(!turn);
+	uint64_t allPieces = GetAllPieces();
+	uint64_t ourPieces = GetPiecesColour(turn);
+
+	checkInfo.checkers = (KnightAttacks[king] & GetPieceBB(KNIGHT, !turn))
+		| ((turn == WHITE ? WhitePawnAttacks[king] : BlackPawnAttacks[king]) & GetPieceBB(PAWN, !turn))
+		| (GetBishopAttacks(king, allPieces) & (GetPieceBB(BISHOP, !turn) | GetPieceBB(QUEEN, !turn)))
+		| (GetRookAttacks(king, allPieces) & (GetPieceBB(ROOK, !turn) | GetPieceBB(QUEEN, !turn)));
+
+	//a slider that would see the king on an empty board, with exactly one piece in the way, has that piece pinned (or ready to give a discovered check)
+	auto lonelyBlockers = [&](unsigned int square, bool attacker)
+	{
+		uint64_t blockers = EMPTY;
+		uint64_t snipers = (GetBishopAttacks(square, EMPTY) & (GetPieceBB(BISHOP, attacker) | GetPieceBB(QUEEN, attacker)))
+			| (GetRookAttacks(square, EMPTY) & (GetPieceBB(ROOK, attacker) | GetPieceBB(QUEEN, attacker)));
+
+		while (snipers != 0)
+		{
+			uint64_t between = inBetweenCache(square, LSPpop(snipers)) & allPieces;
+
+			if (GetBitCount(between) == 1)
+				blockers |= between;
+		}
+
+		return blockers & ourPieces;
+	};
+
+	checkInfo.pinned = lonelyBlockers(king, !turn);
+	checkInfo.discoverers = lonelyBlockers(enemyKing, turn);
+
+	checkInfo.checkSquares[PAWN] = turn == WHITE ? BlackPawnAttacks[enemyKing] : WhitePawnAttacks[enemyKing];	//the squares a pawn of the other colour would attack from the king are where ours attack the king from
+	checkInfo.checkSquares[KNIGHT] = KnightAttacks[enemyKing];
+	checkInfo.checkSquares[BISHOP] = GetBishopAttacks(enemyKing, allPieces);
+	checkInfo.checkSquares[ROOK] = GetRookAttacks(enemyKing, allPieces);
+	checkInfo.checkSquares[QUEEN] = checkInfo.checkSquares[BISHOP] | checkInfo.checkSquares[ROOK];
+	checkInfo.checkSquares[KING] = EMPTY;
+}
+
+bool Position::GivesCheck(Move move) const
+{
+	const CheckInfo& checkInfo = GetCheckInfo();
+	bool turn = GetTurn();
+	unsigned int from = move.GetFrom();
+	unsigned int to = move.GetTo();
+	uint64_t enemyKing = GetPieceBB(KING, !turn);
+	uint64_t allPieces = GetAllPieces();
+
+	if (move.GetFlag() == KING_CASTLE || move.GetFlag() == QUEEN_CASTLE)		//only the rook can give check
+	{
+		unsigned int rookFrom = GetPosition(move.GetFlag() == KING_CASTLE ? FILE_H : FILE_A, GetRank(from));
+		unsigned int rookTo = GetPosition(move.GetFlag() == KING_CASTLE ? FILE_F : FILE_D, GetRank(from));
+		uint64_t occupied = (allPieces ^ SquareBB[from] ^ SquareBB[rookFrom]) | SquareBB[to] | SquareBB[rookTo];
+		return (GetRookAttacks(rookTo, occupied) & enemyKing) != 0;
+	}
+
+	//direct check
+	if (move.IsPromotion())
+	{
+		unsigned int promoted = KNIGHT;
+		if (move.GetFlag() == BISHOP_PROMOTION || move.GetFlag() == BISHOP_PROMOTION_CAPTURE) promoted = BISHOP;
+		if (move.GetFlag() == ROOK_PROMOTION || move.GetFlag() == ROOK_PROMOTION_CAPTURE) promoted = ROOK;
+		if (move.GetFlag() == QUEEN_PROMOTION || move.GetFlag() == QUEEN_PROMOTION_CAPTURE) promoted = QUEEN;
+
+		if ((AttackBB(promoted, to, allPieces ^ SquareBB[from]) & enemyKing) != 0)		//the pawn may have been in the way
+			return true;
+	}
+	else if ((checkInfo.checkSquares[GetSquare(from) % N_PIECE_TYPES] & SquareBB[to]) != 0)
+	{
+		return true;
+	}
+
+	//discovered check. En passant takes a second piece off the board so it can uncover one too
+	if ((checkInfo.discoverers & SquareBB[from]) == 0 && move.GetFlag() != EN_PASSANT)
+		return false;
+
+	uint64_t occupied = (allPieces ^ SquareBB[from]) | SquareBB[to];
+
+	if (move.GetFlag() == EN_PASSANT)
+		occupied ^= SquareBB[GetPosition(GetFile(to), GetRank(from))];
+
+	unsigned int king = LSB(enemyKing);
+	uint64_t queens = GetPieceBB(QUEEN, turn);
+	uint64_t sliders = (GetBishopAttacks(king, occupied) & (GetPieceBB(BISHOP, turn) | queens))
+		| (GetRookAttacks(king, occupied) & (GetPieceBB(ROOK, turn) | queens));
+
+	return (sliders & ~SquareBB[from]) != 0;
+}
+
+uint64_t Position::GetPreviousKey(size_t index) const
 {
-	assert(index < PreviousKeys.size());
-	return PreviousKeys.at(index);
+	assert(index < ply);
+	return states[index].key;
 }
 
 uint64_t Position::GenerateZobristKey() const
@@ -355,7 +515,8 @@ uint64_t Position::GenerateZobristKey() const
 
 uint64_t Position::IncrementZobristKey(Move move)
 {
-	const BoardParamiterData prev = GetPreviousParamiters();
+	uint64_t& key = states[ply].key;
+	const BoardParamiterData& prev = states[ply].previousParamiters;
 
 	//Change of turn
 	key ^= ZobristTable[12 * 64];	//because who's turn it is changed
@@ -380,7 +541,7 @@ uint64_t Position::IncrementZobristKey(Move move)
 
 	//Captures
 	if ((move.IsCapture()) && (move.GetFlag() != EN_PASSANT))
-		key ^= ZobristTable[GetPreviousBoard().GetSquare(move.GetTo()) * 64 + move.GetTo()];
+		key ^= ZobristTable[states[ply].captured * 64 + move.GetTo()];
 
 	//Castling
 	if (CanCastleWhiteKingside() != prev.CanCastleWhiteKingside())					//if casteling rights changed, flip that one
@@ -443,6 +604,32 @@ std::array<int16_t, INPUT_NEURONS> Position::GetInputLayer() const
 	return ret;
 }
 
+NetworkInput Position::GetNetworkInput() const
+{
+	assert(GetBitCount(GetAllPieces()) <= MAX_ACTIVE_INPUTS);
+
+	NetworkInput ret;
+	size_t block = 0;
+
+	for (int side = WHITE; side >= BLACK; side--)
+	{
+		for (int piece = PAWN; piece <= KING; piece++)
+		{
+			uint64_t bb = GetPieceBB(Piece(piece, side));
+
+			while (bb != 0)
+			{
+				ret.active[ret.count++] = static_cast<uint16_t>(block * N_SQUARES + LSB(bb));
+				bb &= bb - 1;
+			}
+
+			block++;
+		}
+	}
+
+	return ret;
+}
+
 deltaArray& Position::CalculateMoveDelta(Move move)
 {
 	delta.size = 0;
@@ -466,7 +653,7 @@ deltaArray& Position::CalculateMoveDelta(Move move)
 	//Captures
 	if ((move.IsCapture()) && (move.GetFlag() != EN_PASSANT))
 	{
-		delta.deltas[delta.size].index = modifier(GetPreviousBoard().GetSquare(move.GetTo()) * 64 + move.GetTo());
+		delta.deltas[delta.size].index = modifier(states[ply].captured * 64 + move.GetTo());
 		delta.deltas[delta.size++].delta = -1;
 	}
 
@@ -521,20 +708,12 @@ size_t Position::modifier(size_t index)
 	}
 }
 
-void Position::ApplySEECapture(Move move)
-{
-	SaveBoard();
-
-	SetSquare(move.GetTo(), GetSquare(move.GetFrom()));
-	ClearSquare(move.GetFrom());
-}
-
-void Position::RevertSEECapture()
+int16_t Position::GetEvaluation()
 {
-	RestorePreviousBoard();
+	return net.QuickEval();
 }
 
-int16_t Position::GetEvaluation()
+void Position::ReloadNetwork()
 {
-	return net.QuickEval();
+	net.RecalculateIncremental(GetInputLayer());
 }
@@ -13,6 +13,34 @@
 constexpr size_t NodeCountChunk = 1 << 12;
 constexpr size_t NodeChunkMask = NodeCountChunk - 1;
 
+/*
+Everything about checks in a position, worked out once when we get to it so the search and move generation don't have to keep
+scanning for attacks on the king. 'Our' is the side to move.
+*/
+struct CheckInfo
+{
+	uint64_t checkers = 0;							//enemy pieces attacking our king
+	uint64_t pinned = 0;							//our pieces that are the only thing between our king and an enemy slider
+	uint64_t discoverers = 0;						//our pieces that are the only thing between the enemy king and one of our sliders
+	uint64_t checkSquares[N_PIECE_TYPES] = {};		//squares where each of our piece types would attack the enemy king. None for the king
+};
+
+/*
+One entry per ply on the position's state stack. It holds what we know about the position at that ply, and what RevertMove
+needs to take back the move that got us there.
+*/
+struct PositionState
+{
+	uint64_t key = 0;
+	CheckInfo checkInfo;
+
+	Move move;										//the move that led here, or uninitialized for a null move
+	unsigned int captured = N_PIECES;				//what it took off its to square (not set for en passant, it's always a pawn)
+	BoardParamiterData previousParamiters;			//castle rights, ep, fifty move count etc from before the move
+};
+
+constexpr size_t STATE_STACK_SIZE = 1024;			//plies of game history plus search. Grown if a game gets this long, but never during a search
+
 /*
 This class holds all the data required to define a chess board position, as well as some functions to manipulate and extract this data in convienient ways.
 */
@@ -25,6 +53,7 @@ public:
 
 	void ApplyMove(Move move);
 	void ApplyMove(std::string strmove);
+	void ApplyMoves(const std::vector<std::string>& strmoves);		//a list of game moves, refreshing the network just once at the end
 	void RevertMove();
 
 	void ApplyNullMove();
@@ -39,18 +68,21 @@ public:
 
 	uint64_t GetZobristKey() const;
 
-	void Reset();
+	const CheckInfo& GetCheckInfo() const { return states[ply].checkInfo; }
+	uint64_t GetCheckers() const { return states[ply].checkInfo.checkers; }
+	bool GivesCheck(Move move) const;						//would this (legal) move put the enemy in check
 
-	size_t GetPreviousKeysSize() const { return PreviousKeys.size(); }
-	uint64_t GetPreviousKey(size_t index);
+	void Reset();
 
-	/*Seriously, don't use these functions outside of static exchange evaluation*/
-	void ApplySEECapture(Move move);	//does ApplyMove functionality but much quicker. Only for use within see() and seeAttack()
-	void RevertSEECapture();			//does RevertMove functionality but much quicker. Only for use within see() and seeAttack()
+	size_t GetPreviousKeysSize() const { return ply; }
+	uint64_t GetPreviousKey(size_t index) const;
 
 	Network net;
 
 	int16_t GetEvaluation();
+	void ReloadNetwork();										//call after the network weights have been changed with LoadNetwork
+	NetworkInput GetNetworkInput() const;						//the active inputs, for EvaluateBatch
+	using BitBoard::InitialiseBoardFromFen;					//sets up the pieces and nothing else, which is all GetNetworkInput needs. Don't search or evaluate the position afterwards
 
 	void addTbHit() { tbHits++; }
 	bool NodesSearchedAddToThreadTotal() { return (nodesSearched & NodeChunkMask) == 0; }
@@ -61,8 +93,11 @@ private:
 	size_t nodesSearched;
 	size_t tbHits;
 
-	uint64_t key;
-	std::vector<uint64_t> PreviousKeys;
+	std::vector<PositionState> states;				//allocated up front: ApplyMove just writes the next entry
+	size_t ply;										//states[ply] is the current position
+
+	void UpdateCheckInfo();
+	void ApplyGameMove(const std::string& strmove);	//leaves the network out of date
 
 	uint64_t GenerateZobristKey() const;
 	uint64_t IncrementZobristKey(Move move);	
@@ -1,4 +1,5 @@
 #include "Search.h"
+#include "MovePicker.h"
 
 constexpr unsigned int FutilityMaxDepth = 15;
 int FutilityMargins[FutilityMaxDepth];
@@ -6,18 +7,20 @@ const unsigned int R = 3;					//Null-move reduction depth
 const unsigned int VariableNullDepth = 7;	//Beyond this depth R = 4
 
 TranspositionTable tTable;
+bool ReportEvalCacheStats = false;
 
-void OrderMoves(std::vector<Move>& moves, Position& position, int distanceFromRoot, SearchData& locals);
 void PrintSearchInfo(unsigned int depth, double Time, bool isCheckmate, int score, int alpha, int beta, const Position& position, const Move& move, const SearchData& locals, const ThreadSharedData& sharedData);
 void PrintBestMove(Move Best);
 bool UseTransposition(TTEntry& entry, int distanceFromRoot, int alpha, int beta);
 bool CheckForRep(Position& position, int distanceFromRoot);
+bool UpcomingRepetition(const Position& position, int distanceFromRoot);		//can the side to move go back to a position we have had before
 bool LMR(bool InCheck, const Position& position);
-bool IsFutile(Move move, int beta, int alpha, bool InCheck, const Position& position);
+bool IsFutile(Move move, int beta, int alpha, bool InCheck, const Position& position);		//call before applying the move
 bool AllowedNull(bool allowedNull, const Position& position, int beta, int alpha);
 bool IsEndGame(const Position& position);
 bool IsPV(int beta, int alpha);
-void AddScoreToTable(int Score, int alphaOriginal, const Position& position, int depthRemaining, int distanceFromRoot, int beta, Move bestMove);
+void AddScoreToTable(int Score, int alphaOriginal, const Position& position, int depthRemaining, int distanceFromRoot, int beta, Move bestMove, int staticEval);
+int StaticEvaluation(Position& position, const TTEntry& entry, bool ttHit, SearchData& locals);
 void UpdateBounds(const TTEntry& entry, int& alpha, int& beta);
 int TerminalScore(const Position& position, int distanceFromRoot);
 int extension(Position & position, int alpha, int beta);
@@ -37,12 +40,11 @@ SearchResult UseRootTBScore(unsigned int result, int staticEval);
 void SearchPosition(Position position, ThreadSharedData& sharedData, unsigned int threadID, int maxTime, int allocatedTimeMs, int maxSearchDepth = MAX_DEPTH, int mateScore =0, SearchData locals = SearchData());
 SearchResult AspirationWindowSearch(Position& position, int depth, int prevScore, SearchData& locals, ThreadSharedData& sharedData, unsigned int threadID, Timer& searchTime);
 SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthRemaining, int alpha, int beta, int colour, unsigned int distanceFromRoot, bool allowedNull, SearchData& locals, ThreadSharedData& sharedData);
-void UpdateAlpha(int Score, int& a, std::vector<Move>& moves, const size_t& i, unsigned int distanceFromRoot, SearchData& locals);
-void UpdateScore(int newScore, int& Score, Move& bestMove, std::vector<Move>& moves, const size_t& i);
+void UpdateAlpha(int Score, int& a, const Move& move, unsigned int distanceFromRoot, SearchData& locals);
+void UpdateScore(int newScore, int& Score, Move& bestMove, const Move& move);
 SearchResult Quiescence(Position& position, unsigned int initialDepth, int alpha, int beta, int colour, unsigned int distanceFromRoot, int depthRemaining, SearchData& locals, ThreadSharedData& sharedData);
 
-int see(Position& position, int square, bool side);
-int seeCapture(Position& position, const Move& move); //Don't send this an en passant move!
+int SEECaptureGain(const Position& position, const Move& move, int& onSquare);		//what the first capture wins, and the value of the piece left on the square
 
 void InitSearch();
 
@@ -63,6 +65,7 @@ Move MultithreadedSearch(const Position& position, unsigned int maxTimeMs, unsig
 		threads[i].join();
 	}
 
+	sharedData.ReportTTEvalHits();
 	PrintBestMove(sharedData.GetBestMove());
 	return sharedData.GetBestMove();
 }
@@ -87,6 +90,7 @@ void MateSearch(const Position& position, int searchTime, int mate)
 	tTable.ResetTable();
 	ThreadSharedData sharedData(1);
 	SearchPosition(position, sharedData, 0, searchTime, searchTime, MAX_DEPTH, mate);
+	sharedData.ReportTTEvalHits();
 	PrintBestMove(sharedData.GetBestMove());
 }
 
@@ -96,6 +100,7 @@ void DepthSearch(const Position& position, int maxSearchDepth)
 	tTable.ResetTable();
 	ThreadSharedData sharedData(1);
 	SearchPosition(position, sharedData, 0, 2147483647, 2147483647, maxSearchDepth);
+	sharedData.ReportTTEvalHits();
 	PrintBestMove(sharedData.GetBestMove());
 }
 
@@ -112,125 +117,111 @@ void InitSearch()
 	}
 }
 
-void OrderMoves(std::vector<Move>& moves, Position& position, int distanceFromRoot, SearchData& locals)
+int See(const Position& position, const Move& move)
 {
 	/*
-	We want to order the moves such that the best moves are more likely to be further towards the front.
-
-	The order is as follows:
+	Play out every capture on the target square, least valuable attacker first, and record the material each side has won so far.
+	Then go back through the list: at each step the side to move can choose to stop capturing instead. Nothing is moved on the board,
+	we just take each attacker out of the occupancy, which also uncovers any slider lined up behind it.
+	*/
 
-	1. Hash move												= 10m
-	2. Queen Promotions											= 9m
-	3. Winning captures											= +8m
-	4. Killer moves												= ~7m
-	5. Losing captures											= -6m
-	6. Quiet moves (further sorted by history matrix values)	= 0-1m
-	7. Underpromotions											= -1
+	unsigned int from = move.GetFrom();
+	unsigned int to = move.GetTo();
+	bool backRank = GetRank(to) == RANK_1 || GetRank(to) == RANK_8;
+	int promotionGain = PieceValues(QUEEN) - PieceValues(PAWN);		//any pawn capturing onto the back rank later becomes a queen
 
-	Note that typically the maximum value of the history matrix does not exceed 1,000,000 after a minute
-	and as such we choose 1m to be the maximum allowed value
+	uint64_t occupied = position.GetAllPieces() ^ SquareBB[from];
+	int gain[32];
+	int onSquare = 0;			//the value of the piece now standing on the target square
+	gain[0] = SEECaptureGain(position, move, onSquare);
 
-	*/
+	if (move.GetFlag() == EN_PASSANT)
+		occupied ^= SquareBB[GetPosition(GetFile(to), GetRank(from))];
 
-	Move TTmove = GetHashMove(position, distanceFromRoot);
+	uint64_t attackers = AttackersTo(position, to, occupied) & occupied;
+	bool side = !position.GetTurn();
+	int depth = 0;
 
-	for (size_t i = 0; i < moves.size(); i++)
+	while (true)
 	{
-		//Hash move
-		if (moves[i] == TTmove)
-		{
-			moves[i].orderScore = 10000000;
-		}
+		uint64_t ours = attackers & position.GetPiecesColour(side);
+		if (ours == 0)
+			break;
 
-		//Promotions
-		else if (moves[i].IsPromotion()) 
-		{
-			if (moves[i].GetFlag() == QUEEN_PROMOTION || moves[i].GetFlag() == QUEEN_PROMOTION_CAPTURE)
-			{
-				moves[i].orderScore = 9000000;
-			}
-			else
-			{
-				moves[i].orderScore = -1;
-			}
-		}
+		unsigned int pieceType = PAWN;
+		while ((ours & position.GetPieceBB(pieceType, side)) == 0)
+			pieceType++;
 
-		//Captures
-		else if (moves[i].IsCapture())
-		{
-			int SEE = 0;
+		depth++;
+		gain[depth] = onSquare - gain[depth - 1];
+		onSquare = PieceValues(pieceType);
 
-			if (moves[i].GetFlag() != EN_PASSANT)
-			{
-				SEE = seeCapture(position, moves[i]);
-			}
+		if (pieceType == PAWN && backRank)
+		{
+			gain[depth] += promotionGain;
+			onSquare += promotionGain;
+		}
 
-			if (SEE >= 0)
-			{
-				moves[i].orderScore = 8000000 + SEE;
-			}
+		if (gain[depth] <= -gain[depth - 1])		//stopping is already at least as good for this side, whatever comes after
+			break;
 
-			if (SEE < 0)
-			{
-				moves[i].orderScore = 6000000 + SEE;
-			}
-		}
+		occupied ^= SquareBB[LSB(ours & position.GetPieceBB(pieceType, side))];
 
-		//Killers
-		else if (moves[i] == locals.KillerMoves.at(distanceFromRoot).move[0])
-		{
-			moves[i].orderScore = 7500000;
-		}
+		if (pieceType == PAWN || pieceType == BISHOP || pieceType == QUEEN)		//x-rays
+			attackers |= GetBishopAttacks(to, occupied) & (position.GetPieceBB(WHITE_BISHOP) | position.GetPieceBB(BLACK_BISHOP) | position.GetPieceBB(WHITE_QUEEN) | position.GetPieceBB(BLACK_QUEEN));
+		if (pieceType == ROOK || pieceType == QUEEN)
+			attackers |= GetRookAttacks(to, occupied) & (position.GetPieceBB(WHITE_ROOK) | position.GetPieceBB(BLACK_ROOK) | position.GetPieceBB(WHITE_QUEEN) | position.GetPieceBB(BLACK_QUEEN));
 
-		else if (moves[i] == locals.KillerMoves.at(distanceFromRoot).move[1])
-		{
-			moves[i].orderScore = 6500000;
-		}
+		attackers &= occupied;
+		side = !side;
+	}
 
-		//Quiet
-		else
-		{
-			moves[i].orderScore = std::min(1000000U, locals.HistoryMatrix[position.GetTurn()][moves[i].GetFrom()][moves[i].GetTo()]);
-		}
+	while (depth > 0)
+	{
+		gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+		depth--;
 	}
 
-	std::stable_sort(moves.begin(), moves.end(), [](const Move& a, const Move& b)
-		{
-			return a.orderScore > b.orderScore;
-		});
+	return gain[0];
 }
 
-int see(Position& position, int square, bool side)
+bool SeeGE(const Position& position, const Move& move, int threshold)
 {
-	int value = 0;
-	Move capture = GetSmallestAttackerMove(position, square, side);
-	
-	if (!capture.IsUninitialized())
-	{
-		int captureValue = PieceValues(position.GetSquare(capture.GetTo()));
+	int onSquare = 0;
+	int gain = SEECaptureGain(position, move, onSquare);
 
-		position.ApplySEECapture(capture);
-		value = std::max(0, captureValue - see(position, square, !side));	// Do not consider captures if they lose material, therefor max zero 
-		position.RevertSEECapture();
-	}
+	if (gain < threshold)						//it can only get worse from here
+		return false;
+
+	int worstRecapture = onSquare + (GetRank(move.GetTo()) == RANK_1 || GetRank(move.GetTo()) == RANK_8 ? PieceValues(QUEEN) - PieceValues(PAWN) : 0);
+	if (gain - worstRecapture >= threshold)		//even if we lose the piece and can't take back
+		return true;
 
-	return value;
+	return See(position, move) >= threshold;
 }
 
-int seeCapture(Position& position, const Move& move)
+int SEECaptureGain(const Position& position, const Move& move, int& onSquare)
 {
-	assert(move.GetFlag() == CAPTURE);	//Don't seeCapture with promotions or en_passant!
+	int gain = 0;
+	onSquare = PieceValues(position.GetSquare(move.GetFrom()));
 
-	bool side = position.GetTurn();
+	if (move.GetFlag() == EN_PASSANT)
+		gain = PieceValues(PAWN);
+	else if (move.IsCapture())
+		gain = PieceValues(position.GetSquare(move.GetTo()));
 
-	int value = 0;
-	int captureValue = PieceValues(position.GetSquare(move.GetTo()));
+	if (move.IsPromotion())
+	{
+		unsigned int promoted = KNIGHT;
+		if (move.GetFlag() == BISHOP_PROMOTION || move.GetFlag() == BISHOP_PROMOTION_CAPTURE) promoted = BISHOP;
+		if (move.GetFlag() == ROOK_PROMOTION || move.GetFlag() == ROOK_PROMOTION_CAPTURE) promoted = ROOK;
+		if (move.GetFlag() == QUEEN_PROMOTION || move.GetFlag() == QUEEN_PROMOTION_CAPTURE) promoted = QUEEN;
 
-	position.ApplySEECapture(move);
-	value = captureValue - see(position, move.GetTo(), !side);
-	position.RevertSEECapture();
+		gain += PieceValues(promoted) - PieceValues(PAWN);
+		onSquare = PieceValues(promoted);
+	}
 
-	return value;
+	return gain;
 }
 
 
@@ -278,8 +269,7 @@ void PrintSearchInfo(unsigned int depth, double Time, bool isCheckmate, int scor
 
 #if defined(_MSC_VER) && !defined(NDEBUG)  
 	std::cout	//these lines are for debug and not part of official uci protocol
-		<< " string thread " << std::this_thread::get_id()
-		<< " evalHitRate " << locals.evalTable.hits * 1000 / std::max(locals.evalTable.hits + locals.evalTable.misses, uint64_t(1));
+		<< " string thread " << std::this_thread::get_id();
 #endif
 
 	std::cout << " pv ";																								//the current best line found
@@ -291,6 +281,15 @@ void PrintSearchInfo(unsigned int depth, double Time, bool isCheckmate, int scor
 	}
 
 	std::cout << std::endl;
+
+	if (ReportEvalCacheStats)
+	{
+		std::cout << "info string evalcache"
+			<< " hits " << locals.evalCacheStats.hits
+			<< " misses " << locals.evalCacheStats.misses
+			<< " hitrate " << locals.evalCacheStats.hits * 1000 / std::max(locals.evalCacheStats.hits + locals.evalCacheStats.misses, uint64_t(1))	//thousondths
+			<< std::endl;
+	}
 }
 
 void SearchPosition(Position position, ThreadSharedData& sharedData, unsigned int threadID, int maxTime, int allocatedTimeMs, int maxSearchDepth, int mateScore, SearchData locals)
@@ -322,6 +321,8 @@ void SearchPosition(Position position, ThreadSharedData& sharedData, unsigned in
 
 		if ((-Score::MateScore) - abs(score) <= 2 * mateScore) break;
 	}
+
+	sharedData.AddTTEvalHits(locals.ttEvalHits);
 }
 
 SearchResult AspirationWindowSearch(Position& position, int depth, int prevScore, SearchData& locals, ThreadSharedData& sharedData, unsigned int threadID, Timer& searchTime)
@@ -367,11 +368,20 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 	if (sharedData.ThreadAbort(initialDepth)) return -1;												//another thread has finished searching this depth: ABORT!
 	if (distanceFromRoot >= MAX_DEPTH) return 0;														//If we are 100 moves from root I think we can assume its a drawn position
 
+	MaterialInfo material = materialTable.Probe(position.GetMaterialKey());
+
 	//check for draw
-	if (DeadPosition(position)) return 0;
+	if (material.deadPosition) return 0;
 	if (CheckForRep(position, distanceFromRoot)) return 0;
 
-	if (distanceFromRoot == 0 && GetBitCount(position.GetAllPieces()) <= TB_LARGEST)
+	if (distanceFromRoot > 0 && alpha < 0 && UpcomingRepetition(position, distanceFromRoot))		//we can force at least a draw
+	{
+		alpha = 0;
+		if (alpha >= beta)
+			return alpha;
+	}
+
+	if (distanceFromRoot == 0 && material.pieceCount <= TB_LARGEST)
 	{
 		//at root
 		unsigned int result = ProbeTBRoot(position);
@@ -379,11 +389,11 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 		{
 			position.addTbHit();
 			if (position.TbHitaddToThreadTotal()) sharedData.AddTBHitChunk();
-			return UseRootTBScore(result, colour * EvaluatePositionNet(position, locals.evalTable));
+			return UseRootTBScore(result, colour * EvaluatePositionNet(position, locals.evalCacheStats));
 		}
 	}
 
-	if (distanceFromRoot > 0 && GetBitCount(position.GetAllPieces()) <= TB_LARGEST)
+	if (distanceFromRoot > 0 && material.pieceCount <= TB_LARGEST)
 	{
 		//not root
 		unsigned int result = ProbeTBSearch(position);
@@ -391,22 +401,26 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 		{
 			position.addTbHit();
 			if (position.TbHitaddToThreadTotal()) sharedData.AddTBHitChunk();
-			return UseSearchTBScore(result, colour * EvaluatePositionNet(position, locals.evalTable));
+			return UseSearchTBScore(result, colour * EvaluatePositionNet(position, locals.evalCacheStats));
 		}
 	}
 
 	/*Query the transpotition table*/
+	TTEntry entry = tTable.GetEntry(position.GetZobristKey());
+	bool ttHit = CheckEntry(entry, position.GetZobristKey());
+
 	if (!IsPV(beta, alpha)) 
 	{
-		TTEntry entry = tTable.GetEntry(position.GetZobristKey());
-		if (CheckEntry(entry, position.GetZobristKey(), depthRemaining))
+		if (ttHit && CheckEntry(entry, position.GetZobristKey(), depthRemaining))
 		{
 			tTable.SetNonAncient(position.GetZobristKey(), position.GetTurnCount(), distanceFromRoot);
 
 			int rep = 1;
 			uint64_t current = position.GetZobristKey();
+			int ply = static_cast<int>(position.GetPreviousKeysSize());
+			int start = std::max<int>(0, ply - static_cast<int>(position.GetFiftyMoveCount()));
 
-			for (unsigned int i = 0; i < position.GetPreviousKeysSize(); i++)	//note Previous keys will not contain the current key, hence rep starts at one
+			for (int i = ply - 2; i >= start; i -= 2)	//note Previous keys will not contain the current key, hence rep starts at one
 			{
 				if (position.GetPreviousKey(i) == current)
 				{
@@ -428,7 +442,8 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 		return Quiescence(position, initialDepth, alpha, beta, colour, distanceFromRoot, depthRemaining, locals, sharedData);
 	}
 
-	int staticScore = colour * EvaluatePositionNet(position, locals.evalTable);
+	int staticEval = StaticEvaluation(position, entry, ttHit, locals);
+	int staticScore = colour * staticEval;
 
 	/*Null move pruning*/
 	if (AllowedNull(allowedNull, position, beta, alpha) && (staticScore > beta))
@@ -467,7 +482,9 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 
 	/*If a hash move exists, search with that move first and hope we can get a cutoff*/
 	Move hashMove = GetHashMove(position, distanceFromRoot);
-	if (!hashMove.IsUninitialized() && position.GetFiftyMoveCount() < 100 && MoveIsLegal(position, hashMove))	//if its 50 move rule we need to skip this and figure out if its checkmate or draw below
+	bool hashMoveSearched = !hashMove.IsUninitialized() && position.GetFiftyMoveCount() < 100 && MoveIsLegal(position, hashMove);	//if its 50 move rule we need to skip this and figure out if its checkmate or draw below
+
+	if (hashMoveSearched)
 	{
 		position.ApplyMove(hashMove);
 		tTable.PreFetch(position.GetZobristKey());							//load the transposition into l1 cache. ~5% speedup
@@ -495,7 +512,7 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 			AddHistory(hashMove, depthRemaining, locals.HistoryMatrix, position.GetTurn());
 
 			if (!locals.AbortSearch(position.GetNodes()) && !(sharedData.ThreadAbort(initialDepth)))
-				AddScoreToTable(Score, alpha, position, depthRemaining, distanceFromRoot, beta, bestMove);
+				AddScoreToTable(Score, alpha, position, depthRemaining, distanceFromRoot, beta, bestMove, staticEval);
 
 			return SearchResult(Score, bestMove);
 		}
@@ -503,17 +520,17 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 		b = a + 1;				//Set a new zero width window
 	}
 
-	std::vector<Move> moves;
-	LegalMoves(position, moves);
-
-	if (moves.size() == 0)
+	if (position.GetFiftyMoveCount() >= 100)	//must make sure its not already checkmate
 	{
-		return TerminalScore(position, distanceFromRoot);
+		MoveList moves;
+		LegalMoves(position, moves);
+
+		if (moves.size() == 0)
+			return TerminalScore(position, distanceFromRoot);
+
+		return 0;
 	}
 
-	if (position.GetFiftyMoveCount() >= 100) return 0;	//must make sure its not already checkmate
-	
-	OrderMoves(moves, position, distanceFromRoot, locals);
 	bool InCheck = IsInCheck(position);
 
 	if (hashMove.IsUninitialized() && depthRemaining > 3)
@@ -521,22 +538,22 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 
 	bool FutileNode = (depthRemaining < FutilityMaxDepth) && (staticScore + FutilityMargins[std::max<int>(0, depthRemaining)] < a);
 
-	for (size_t i = 0; i < moves.size(); i++)	
+	MovePicker picker(position, distanceFromRoot, locals, hashMoveSearched ? hashMove : Move(), false);
+	Move move;
+	bool noLegalMoves = !hashMoveSearched;
+
+	for (size_t i = hashMoveSearched ? 1 : 0; picker.Next(move); i++)	//i counts the hash move if we searched it
 	{
-		if (moves[i] == hashMove)
+		noLegalMoves = false;
+
+		//futility pruning
+		if (FutileNode && i > 0 && IsFutile(move, beta, alpha, InCheck, position))	//Possibly stop futility pruning if alpha or beta are close to mate scores
 			continue;
 
-		position.ApplyMove(moves.at(i));
+		position.ApplyMove(move);
 		tTable.PreFetch(position.GetZobristKey());							//load the transposition into l1 cache. ~5% speedup
 		if (position.NodesSearchedAddToThreadTotal()) sharedData.AddNodeChunk();
 
-		//futility pruning
-		if (IsFutile(moves[i], beta, alpha, InCheck, position) && i > 0 && FutileNode)	//Possibly stop futility pruning if alpha or beta are close to mate scores
-		{
-			position.RevertMove();
-			continue;
-		}
-
 		int extendedDepth = depthRemaining + extension(position, alpha, beta);
 
 		//late move reductions
@@ -560,21 +577,24 @@ SearchResult NegaScout(Position& position, unsigned int initialDepth, int depthR
 
 		position.RevertMove();
 
-		UpdateScore(newScore, Score, bestMove, moves, i);
-		UpdateAlpha(Score, a, moves, i, distanceFromRoot, locals);
+		UpdateScore(newScore, Score, bestMove, move);
+		UpdateAlpha(Score, a, move, distanceFromRoot, locals);
 
 		if (a >= beta) //Fail high cutoff
 		{
-			AddKiller(moves.at(i), distanceFromRoot, locals.KillerMoves);
-			AddHistory(moves[i], depthRemaining, locals.HistoryMatrix, position.GetTurn());
+			AddKiller(move, distanceFromRoot, locals.KillerMoves);
+			AddHistory(move, depthRemaining, locals.HistoryMatrix, position.GetTurn());
 			break;
 		}
 
 		b = a + 1;				//Set a new zero width window
 	}
 
+	if (noLegalMoves)
+		return TerminalScore(position, distanceFromRoot);
+
 	if (!locals.AbortSearch(position.GetNodes()) && !sharedData.ThreadAbort(initialDepth))
-		AddScoreToTable(Score, alpha, position, depthRemaining, distanceFromRoot, beta, bestMove);
+		AddScoreToTable(Score, alpha, position, depthRemaining, distanceFromRoot, beta, bestMove, staticEval);
 
 	return SearchResult(Score, bestMove);
 }
@@ -667,21 +687,21 @@ SearchResult UseRootTBScore(unsigned int result, int staticEval)
 	return { score, move };
 }
 
-void UpdateAlpha(int Score, int& a, std::vector<Move>& moves, const size_t& i, unsigned int distanceFromRoot, SearchData& locals)
+void UpdateAlpha(int Score, int& a, const Move& move, unsigned int distanceFromRoot, SearchData& locals)
 {
 	if (Score > a)
 	{
 		a = Score;
-		UpdatePV(moves.at(i), distanceFromRoot, locals.PvTable);
+		UpdatePV(move, distanceFromRoot, locals.PvTable);
 	}
 }
 
-void UpdateScore(int newScore, int& Score, Move& bestMove, std::vector<Move>& moves, const size_t& i)
+void UpdateScore(int newScore, int& Score, Move& bestMove, const Move& move)
 {
 	if (newScore > Score)
 	{
 		Score = newScore;
-		bestMove = moves.at(i);
+		bestMove = move;
 	}
 }
 
@@ -724,30 +744,65 @@ bool CheckForRep(Position& position, int distanceFromRoot)
 {
 	int totalRep = 1;
 	uint64_t current = position.GetZobristKey();
+	int ply = static_cast<int>(position.GetPreviousKeysSize());
+
+	/*
+	Note Previous keys will not contain the current key, hence rep starts at one. Only positions with the same side to move and
+	since the last capture or pawn move can be the same, so we look back two plies at a time no further than the fifty move count
+	*/
+	int start = std::max<int>(0, ply - static_cast<int>(position.GetFiftyMoveCount()));
 
-	//note Previous keys will not contain the current key, hence rep starts at one
-	for (size_t i = 0; i < position.GetPreviousKeysSize(); i++)
+	for (int i = ply - 2; i >= start; i -= 2)
 	{
 		if (position.GetPreviousKey(i) == current)
 		{
 			totalRep++;
-		}
 
-		if (totalRep == 3) return true;																			//3 reps is always a draw
-		if (totalRep == 2 && static_cast<int>(position.GetPreviousKeysSize() - i) < distanceFromRoot - 1) 
-			return true;			//Don't allow 2 reps if its in the local search history (not part of the actual played game)
+			if (totalRep == 3) return true;				//3 reps is always a draw
+			if (distanceFromRoot > 2) return true;		//Once we are a few moves into the search, 2 reps is enough
+		}
 	}
 	
 	return false;
 }
 
+bool UpcomingRepetition(const Position& position, int distanceFromRoot)
+{
+	int ply = static_cast<int>(position.GetPreviousKeysSize());
+	int end = std::min<int>(ply, position.GetFiftyMoveCount());
+	uint64_t current = position.GetZobristKey();
+
+	//the position 1 ply ago can't be one move away with us to move after it, so start 3 back and look at every other one
+	for (int i = 3; i <= end; i += 2)
+	{
+		Move move;
+
+		if (!CuckooLookup(current ^ position.GetPreviousKey(ply - i), move))
+			continue;
+
+		if ((inBetweenCache(move.GetFrom(), move.GetTo()) & position.GetAllPieces()) != 0)
+			continue;
+
+		if (distanceFromRoot > i)						//the earlier position is in the search tree
+			return true;
+
+		//it's from the game, so make sure it's our piece that can go back rather than their piece that just moved here. Then CheckForRep will call it a draw if it's past the first couple of plies
+		unsigned int square = position.IsEmpty(move.GetFrom()) ? move.GetTo() : move.GetFrom();
+
+		if (ColourOfPiece(position.GetSquare(square)) == position.GetTurn() && distanceFromRoot + 1 > 2)
+			return true;
+	}
+
+	return false;
+}
+
 int extension(Position& position, int alpha, int beta)
 {
 	int extension = 0;
 
 	if (IsPV(beta, alpha))
 	{
-		if (IsSquareThreatened(position, position.GetKing(position.GetTurn()), position.GetTurn()))	
+		if (IsInCheck(position))
 			extension += 1;
 	}
 
@@ -767,21 +822,21 @@ bool IsFutile(Move move, int beta, int alpha, bool InCheck, const Position& posi
 		&& !move.IsCapture() 
 		&& !move.IsPromotion() 
 		&& !InCheck 
-		&& !IsInCheck(position);
+		&& !position.GivesCheck(move);
 }
 
 bool AllowedNull(bool allowedNull, const Position& position, int beta, int alpha)
 {
 	return allowedNull
-		&& !IsSquareThreatened(position, position.GetKing(position.GetTurn()), position.GetTurn())
+		&& !IsInCheck(position)
 		&& !IsPV(beta, alpha)
 		&& !IsEndGame(position)
-		&& GetBitCount(position.GetAllPieces()) >= 5;	//avoid null move pruning in very late game positions due to zanauag issues. Even with verification search e.g 8/6k1/8/8/8/8/1K6/Q7 w - - 0 1 
+		&& materialTable.Probe(position.GetMaterialKey()).pieceCount >= 5;	//avoid null move pruning in very late game positions due to zanauag issues. Even with verification search e.g 8/6k1/8/8/8/8/1K6/Q7 w - - 0 1 
 }
 
 bool IsEndGame(const Position& position)
 {
-	return (position.GetAllPieces() == (position.GetPieceBB(WHITE_KING) | position.GetPieceBB(BLACK_KING) | position.GetPieceBB(WHITE_PAWN) | position.GetPieceBB(BLACK_PAWN)));
+	return materialTable.Probe(position.GetMaterialKey()).pawnEndgame;
 }
 
 bool IsPV(int beta, int alpha)
@@ -789,14 +844,26 @@ bool IsPV(int beta, int alpha)
 	return beta != alpha + 1;
 }
 
-void AddScoreToTable(int Score, int alphaOriginal, const Position& position, int depthRemaining, int distanceFromRoot, int beta, Move bestMove)
+void AddScoreToTable(int Score, int alphaOriginal, const Position& position, int depthRemaining, int distanceFromRoot, int beta, Move bestMove, int staticEval)
 {
 	if (Score <= alphaOriginal)
-		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::UPPERBOUND);	//mate score adjustent is done inside this function
+		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, staticEval, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::UPPERBOUND);	//mate score adjustent is done inside this function
 	else if (Score >= beta)
-		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::LOWERBOUND);
+		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, staticEval, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::LOWERBOUND);
 	else
-		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::EXACT);
+		tTable.AddEntry(bestMove, position.GetZobristKey(), Score, staticEval, depthRemaining, position.GetTurnCount(), distanceFromRoot, EntryType::EXACT);
+}
+
+int StaticEvaluation(Position& position, const TTEntry& entry, bool ttHit, SearchData& locals)
+{
+	//every entry stored by the search carries the static eval of its position, so a hit saves us running the network
+	if (ttHit)
+	{
+		locals.ttEvalHits++;
+		return entry.GetStaticEval();
+	}
+
+	return EvaluatePositionNet(position, locals.evalCacheStats);
 }
 
 void UpdateBounds(const TTEntry& entry, int& alpha, int& beta)
@@ -814,7 +881,7 @@ void UpdateBounds(const TTEntry& entry, int& alpha, int& beta)
 
 int TerminalScore(const Position& position, int distanceFromRoot)
 {
-	if (IsSquareThreatened(position, position.GetKing(position.GetTurn()), position.GetTurn()))
+	if (IsInCheck(position))
 	{
 		return matedIn(distanceFromRoot);
 	}
@@ -842,7 +909,7 @@ SearchResult Quiescence(Position& position, unsigned int initialDepth, int alpha
 	if (sharedData.ThreadAbort(initialDepth)) return -1;									//another thread has finished searching this depth: ABORT!
 	if (distanceFromRoot >= MAX_DEPTH) return 0;								//If we are 100 moves from root I think we can assume its a drawn position
 
-	std::vector<Move> moves;
+	MoveList moves;
 
 	/*Check for checkmate*/
 	if (IsInCheck(position))
@@ -857,46 +924,28 @@ SearchResult Quiescence(Position& position, unsigned int initialDepth, int alpha
 		moves.clear();
 	}
 
-	int staticScore = colour * EvaluatePositionNet(position, locals.evalTable);
+	TTEntry entry = tTable.GetEntry(position.GetZobristKey());
+	int staticScore = colour * StaticEvaluation(position, entry, CheckEntry(entry, position.GetZobristKey()), locals);
 	if (staticScore >= beta) return staticScore;
 	if (staticScore > alpha) alpha = staticScore;
 	
 	Move bestmove;
 	int Score = staticScore;
 
-	QuiescenceMoves(position, moves);
+	MovePicker picker(position, distanceFromRoot, locals, Move(), true);
+	Move move;
 
-	if (moves.size() == 0)
-		return staticScore;
-		
-	OrderMoves(moves, position, distanceFromRoot, locals);
-
-	for (size_t i = 0; i < moves.size(); i++)
+	while (picker.Next(move))
 	{
-		int SEE = 0;
-		if (moves[i].GetFlag() == CAPTURE) //seeCapture doesn't work for ep or promotions
-		{
-			SEE = seeCapture(position, moves[i]);
-		}
+		//the picker only gives us captures and queen promotions that don't lose material
 
-		if (moves[i].IsPromotion())
-		{
-			SEE += PieceValues(WHITE_QUEEN);
-		}
-
-		if (staticScore + SEE + 200 < alpha) 								//delta pruning
-			break;
-
-		if (SEE < 0)														//prune bad captures
-			break;
-
-		if (SEE <= 0 && position.GetCaptureSquare() != moves[i].GetTo())	//prune equal captures that aren't recaptures
+		if (!SeeGE(position, move, alpha - staticScore - 200)) 								//delta pruning
 			continue;
 
-		if (moves[i].IsPromotion() && !(moves[i].GetFlag() == QUEEN_PROMOTION || moves[i].GetFlag() == QUEEN_PROMOTION_CAPTURE))	//prune underpromotions
+		if (position.GetCaptureSquare() != move.GetTo() && !SeeGE(position, move, 1))		//prune equal captures that aren't recaptures
 			continue;
 
-		position.ApplyMove(moves.at(i));
+		position.ApplyMove(move);
 		int newScore = -Quiescence(position, initialDepth, -beta, -alpha, -colour, distanceFromRoot + 1, depthRemaining - 1, locals, sharedData).GetScore();
 		position.RevertMove();
 
@@ -904,14 +953,14 @@ SearchResult Quiescence(Position& position, unsigned int initialDepth, int alpha
 
 		if (newScore > Score)
 		{
-			bestmove = moves.at(i);
+			bestmove = move;
 			Score = newScore;
 		}
 
 		if (Score > alpha)
 		{
 			alpha = Score;
-			UpdatePV(moves.at(i), distanceFromRoot, locals.PvTable);
+			UpdatePV(move, distanceFromRoot, locals.PvTable);
 		}
 
 		if (Score >= beta)
@@ -999,6 +1048,7 @@ ThreadSharedData::ThreadSharedData(unsigned int threads, bool NoOutput) : curren
 	noOutput = NoOutput;
 	tbHits = 0;
 	nodes = 0;
+	ttEvalHits = 0;
 
 	for (unsigned int i = 0; i < threads; i++)
 	{
@@ -1011,6 +1061,12 @@ ThreadSharedData::~ThreadSharedData()
 {
 }
 
+void ThreadSharedData::ReportTTEvalHits() const
+{
+	if (!noOutput)
+		std::cout << "info string ttEvalHits " << ttEvalHits << std::endl;
+}
+
 Move ThreadSharedData::GetBestMove()
 {
 	std::lock_guard<std::mutex> lg(ioMutex);
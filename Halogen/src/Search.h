@@ -46,7 +46,8 @@ struct SearchData
 	std::vector<std::vector<Move>> PvTable;
 	std::vector<Killer> KillerMoves;							//2 moves indexed by distanceFromRoot
 	unsigned int HistoryMatrix[N_PLAYERS][N_SQUARES][N_SQUARES];			//first index is from square and 2nd index is to square
-	EvalCacheTable evalTable;
+	EvalCacheStats evalCacheStats;							//hits and misses in the shared evalCache by this thread
+	uint64_t ttEvalHits = 0;									//network evaluations skipped because the static eval came from the transposition table
 	SearchTimeManage timeManage;
 
 	bool AbortSearch(size_t nodes);
@@ -72,6 +73,9 @@ public:
 	void AddNodeChunk() { nodes += NodeCountChunk; }
 	void AddTBHitChunk() { tbHits += NodeCountChunk; }
 
+	void AddTTEvalHits(uint64_t hits) { ttEvalHits += hits; }		//each thread adds its total when it finishes searching
+	void ReportTTEvalHits() const;									//once all the threads have finished
+
 private:
 	std::mutex ioMutex;
 	unsigned int threadCount;
@@ -82,15 +86,20 @@ private:
 
 	std::atomic<uint64_t> tbHits;
 	std::atomic<uint64_t> nodes;
+	std::atomic<uint64_t> ttEvalHits;				//network evaluations skipped because the static eval came from the transposition table, over all threads
 
 	std::vector<unsigned int> searchDepth;			//what depth is each thread currently searching?
 	std::vector<bool> ThreadWantsToStop;			//Threads signal here that they want to stop searching, but will keep going until all threads want to stop
 };
 
 extern TranspositionTable tTable;
+extern bool ReportEvalCacheStats;						//add an info string with the evalcache hits and misses to each search info line
 
 Move MultithreadedSearch(const Position& position, unsigned int maxTimeMs, unsigned int AllocatedTimeMs, unsigned int threadCount = 1, int maxSearchDepth = MAX_DEPTH);
 uint64_t BenchSearch(const Position& position, int maxSearchDepth = MAX_DEPTH);
 void DepthSearch(const Position& position, int maxSearchDepth);
 void MateSearch(const Position& position, int searchTime, int mate);
 
+int See(const Position& position, const Move& move);						//static exchange evaluation of any capture or promotion
+bool SeeGE(const Position& position, const Move& move, int threshold);		//See(move) >= threshold, usually without the full exchange
+
@@ -5,24 +5,37 @@ TTEntry::TTEntry()
 	key = EMPTY;
 	bestMove.data = 0;
 	score = -1;
+	staticEval = 0;
 	depth = -1;
 	cutoff = EntryType::EMPTY_ENTRY;
 	halfmove = -1;
 }
 
-TTEntry::TTEntry(Move best, uint64_t ZobristKey, int Score, int Depth, int currentTurnCount, int distanceFromRoot, EntryType Cutoff)
+TTEntry::TTEntry(Move best, uint64_t ZobristKey, int Score, int StaticEval, int Depth, int currentTurnCount, int distanceFromRoot, EntryType Cutoff)
 {
 	assert(Score < SHRT_MAX && Score > SHRT_MIN);
+	assert(StaticEval < SHRT_MAX && StaticEval > SHRT_MIN);
 	assert(Depth < CHAR_MAX && Depth > CHAR_MIN);
 
 	key = ZobristKey;
 	bestMove.data = best.GetBits();
 	score = static_cast<short>(Score);
+	staticEval = static_cast<short>(StaticEval);
 	depth = static_cast<char>(Depth);
 	cutoff = Cutoff;
 	SetHalfMove(currentTurnCount, distanceFromRoot);
 }
 
+TTEntry::TTEntry(uint64_t ZobristKey, uint64_t data)
+{
+	key = ZobristKey;
+	bestMove.data = static_cast<unsigned short>(data);
+	score = static_cast<short>(data >> 16);
+	depth = static_cast<char>(data >> 32);
+	cutoff = static_cast<EntryType>((data >> 40) & 0x3);
+	halfmove = static_cast<char>((data >> 42) & (HALF_MOVE_MODULO - 1));
+	staticEval = static_cast<short>(data >> 48);
+}
 
 TTEntry::~TTEntry()
 {
@@ -36,11 +49,22 @@ void TTEntry::MateScoreAdjustment(int distanceFromRoot)
 		score += static_cast<short>(distanceFromRoot);
 }
 
+uint64_t TTEntry::GetData() const
+{
+	return static_cast<uint64_t>(bestMove.data)
+		| static_cast<uint64_t>(static_cast<unsigned short>(score)) << 16
+		| static_cast<uint64_t>(static_cast<unsigned char>(depth)) << 32
+		| static_cast<uint64_t>(static_cast<unsigned char>(cutoff) & 0x3) << 40
+		| static_cast<uint64_t>(static_cast<unsigned char>(halfmove) & (HALF_MOVE_MODULO - 1)) << 42
+		| static_cast<uint64_t>(static_cast<unsigned short>(staticEval)) << 48;
+}
+
 void TTEntry::Reset()
 {
 	bestMove.data = 0;
 	key = EMPTY;
 	score = -1;
+	staticEval = 0;
 	depth = -1;
 	cutoff = EntryType::EMPTY_ENTRY;
 	halfmove = -1;
@@ -12,21 +12,26 @@ enum class EntryType : char {
 	UPPERBOUND
 };
 
-//16 bytes
+/*
+TTEntry is what the search works with. In the table itself everything except the key is packed into 64 bits (see GetData)
+*/
 class TTEntry
 {
 public:
 	TTEntry();
-	TTEntry(Move best, uint64_t ZobristKey, int Score, int Depth, int currentTurnCount, int distanceFromRoot, EntryType Cutoff);
+	TTEntry(Move best, uint64_t ZobristKey, int Score, int StaticEval, int Depth, int currentTurnCount, int distanceFromRoot, EntryType Cutoff);
+	TTEntry(uint64_t ZobristKey, uint64_t data);	//unpacks an entry that was stored with GetData()
 	~TTEntry();
 
 	uint64_t GetKey() const { return key; }
 	int GetScore() const { return score; } 	
+	int GetStaticEval() const { return staticEval; }	//from whites point of view, as returned by EvaluatePositionNet
 	int GetDepth() const { return depth; }
 	bool IsAncient(unsigned int currenthalfmove, unsigned int distanceFromRoot) const { return halfmove != static_cast<char>((currenthalfmove - distanceFromRoot) % (HALF_MOVE_MODULO)); }
 	EntryType GetCutoff() const { return cutoff; }
 	Move GetMove() const { return Move(bestMove.data); }
 	char GetHalfMove() const { return halfmove; }
+	uint64_t GetData() const;	//move, score, depth, the cutoff and halfmove sharing one byte, and the static eval
 
 	void SetHalfMove(int currenthalfmove, int distanceFromRoot) { halfmove = (currenthalfmove - distanceFromRoot) % (HALF_MOVE_MODULO); }	//halfmove is from current position, distanceFromRoot adjusts this to get what the halfmove was at the root of the search
 	void MateScoreAdjustment(int distanceFromRoot);
@@ -39,6 +44,7 @@ private:
 	uint64_t key;			//8 bytes
 	MoveBits bestMove;		//2 bytes 
 	short int score;		//2 bytes
+	short int staticEval;	//2 bytes
 	char depth;				//1 bytes
 	EntryType cutoff;		//1 bytes
 	char halfmove;			//1 bytes		(is stored as the halfmove at the ROOT of this current search, modulo 16)
@@ -1,12 +1,60 @@
 #include "TranspositionTable.h"
 
-TranspositionTable::TranspositionTable()
+#include "TimeManage.h"
+#include "Network.h"
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <cstdio>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/*
+Hash file layout: a header padded out to TT_FILE_HEADER_SIZE, followed by the raw buckets exactly as they sit in memory.
+The padding keeps the buckets page aligned within the file, so that the file can be mapped and used as the table directly.
+*/
+constexpr char TT_FILE_MAGIC[8] = { 'H', 'A', 'L', 'O', 'H', 'A', 'S', 'H' };
+constexpr uint32_t TT_FILE_VERSION = 2;
+constexpr size_t TT_FILE_HEADER_SIZE = 4096;
+
+struct TTFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entryLayout;
+	uint32_t entrySize;
+	uint32_t bucketSize;
+	uint64_t bucketCount;
+	uint64_t hashMB;
+	uint64_t networkHash;		//the stored evals and scores only make sense with the network that produced them
+};
+
+bool IsCompatible(const TTFileHeader& header);
+
+int ReplacementPriority(const TTEntry& entry, int Turncount, int distanceFromRoot);	//lower values are replaced first
+
+TranspositionTable::TranspositionTable() : table(nullptr), size(0), hugePages(false), mapping(nullptr), mappingSize(0)
 {
-	table.push_back(TTEntry());
+	Allocate(1000 / TTBucketSize);
+	ResetTable();
 }
 
 TranspositionTable::~TranspositionTable()
 {
+	Deallocate();
 }
 
 bool CheckEntry(const TTEntry& entry, uint64_t key, int depth)
@@ -18,8 +66,17 @@ bool CheckEntry(const TTEntry& entry, uint64_t key, int depth)
 
 uint64_t TranspositionTable::HashFunction(const uint64_t& key) const
 {
-	return key % table.size();
-	//return key & 0x3FFFFF;
+	//maps the key onto [0, size) using its high bits, without the cost of a 64 bit division
+#if defined(__SIZEOF_INT128__)
+	return static_cast<uint64_t>((static_cast<unsigned __int128>(key) * size) >> 64);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	return __umulh(key, size);
+#else
+	uint64_t keyLow = key & 0xFFFFFFFF, keyHigh = key >> 32;
+	uint64_t sizeLow = size & 0xFFFFFFFF, sizeHigh = size >> 32;
+	uint64_t middle = (keyLow * sizeLow >> 32) + (keyHigh * sizeLow & 0xFFFFFFFF) + (keyLow * sizeHigh & 0xFFFFFFFF);
+	return keyHigh * sizeHigh + (keyHigh * sizeLow >> 32) + (keyLow * sizeHigh >> 32) + (middle >> 32);
+#endif
 }
 
 bool CheckEntry(const TTEntry& entry, uint64_t key)
@@ -29,71 +86,170 @@ bool CheckEntry(const TTEntry& entry, uint64_t key)
 	return false;
 }
 
-void TranspositionTable::AddEntry(const Move& best, uint64_t ZobristKey, int Score, int Depth, int Turncount, int distanceFromRoot, EntryType Cutoff)
+void TranspositionTable::AddEntry(const Move& best, uint64_t ZobristKey, int Score, int StaticEval, int Depth, int Turncount, int distanceFromRoot, EntryType Cutoff)
 {
 	if (!HASH_ENABLE)
 		return;
 
-	size_t hash = HashFunction(ZobristKey);
+	TTBucket& bucket = table[HashFunction(ZobristKey)];
 
 	if (Score > 9000)	//checkmate node
 		Score += distanceFromRoot;
 	if (Score < -9000)
 		Score -= distanceFromRoot;
 
+	/*
+	If this position is already in the bucket we only overwrite it under the same conditions as before (the entry is shallower, ancient or empty).
+	Otherwise we evict the least valuable entry in the bucket: empty and ancient entries go first, and then the shallowest.
+	*/
+	uint64_t verification = TTSlot::VerificationKey(ZobristKey);
+	TTEntry entries[TTBucketSize];
+	size_t replace = TTBucketSize;
 
-	if ((table.at(hash).GetKey() == EMPTY) || (table.at(hash).GetDepth() <= Depth) || (table.at(hash).IsAncient(Turncount, distanceFromRoot)) || table.at(hash).GetCutoff() == EntryType::EMPTY_ENTRY)
+	for (size_t i = 0; i < TTBucketSize; i++)
 	{
-		table.at(hash) = TTEntry(best, ZobristKey, Score, Depth, Turncount, distanceFromRoot, Cutoff);
+		uint64_t stored, packed;
+		bucket.entry[i].Read(stored, packed);
+		entries[i] = TTEntry(stored, packed);
+
+		if (replace == TTBucketSize && stored == verification && entries[i].GetCutoff() != EntryType::EMPTY_ENTRY)
+			replace = i;
 	}
+
+	if (replace != TTBucketSize)
+	{
+		if (entries[replace].GetDepth() > Depth && !entries[replace].IsAncient(Turncount, distanceFromRoot))
+			return;
+	}
+	else
+	{
+		replace = 0;
+
+		for (size_t i = 1; i < TTBucketSize; i++)
+		{
+			if (ReplacementPriority(entries[i], Turncount, distanceFromRoot) < ReplacementPriority(entries[replace], Turncount, distanceFromRoot))
+				replace = i;
+		}
+	}
+
+	bucket.entry[replace].Write(verification, TTEntry(best, ZobristKey, Score, StaticEval, Depth, Turncount, distanceFromRoot, Cutoff).GetData());
 }
 
 TTEntry TranspositionTable::GetEntry(uint64_t key)
 {
-	return table.at(HashFunction(key));
+	const TTBucket& bucket = table[HashFunction(key)];
+	uint64_t verification = TTSlot::VerificationKey(key);
+
+	for (size_t i = 0; i < TTBucketSize; i++)
+	{
+		uint64_t stored, packed;
+		bucket.entry[i].Read(stored, packed);
+
+		if (stored == verification)
+			return TTEntry(key, packed);
+	}
+
+	return TTEntry();
 }
 
 void TranspositionTable::SetNonAncient(uint64_t key, int halfmove, int distanceFromRoot)
 {
-	table.at(HashFunction(key)).SetHalfMove(halfmove, distanceFromRoot);
+	TTBucket& bucket = table[HashFunction(key)];
+	uint64_t verification = TTSlot::VerificationKey(key);
+
+	for (size_t i = 0; i < TTBucketSize; i++)
+	{
+		uint64_t stored, packed;
+		bucket.entry[i].Read(stored, packed);
+
+		if (stored == verification)
+		{
+			TTEntry entry(key, packed);
+			entry.SetHalfMove(halfmove, distanceFromRoot);
+			bucket.entry[i].Write(verification, entry.GetData());
+			return;
+		}
+	}
 }
 
 int TranspositionTable::GetCapacity(int halfmove) const
 {
 	int count = 0;
 
-	for (int i = 0; i < 1000; i++)	//1000 chosen specifically, because result needs to be 'per mill'
+	for (size_t i = 0; i < 1000 / TTBucketSize; i++)	//1000 chosen specifically, because result needs to be 'per mill'
 	{
-		if (table.at(i).GetHalfMove() == static_cast<char>(halfmove % HALF_MOVE_MODULO))
-			count++;
+		for (size_t j = 0; j < TTBucketSize; j++)
+		{
+			uint64_t stored, packed;
+			table[i].entry[j].Read(stored, packed);
+			TTEntry entry(stored, packed);
+
+			if (entry.GetCutoff() != EntryType::EMPTY_ENTRY && entry.GetHalfMove() == static_cast<char>(halfmove % HALF_MOVE_MODULO))
+				count++;
+		}
 	}
 
 	return count;
 }
 
-void TranspositionTable::ResetTable()
+void TranspositionTable::ResetTable(unsigned int threads, bool report)
 {
-	for (size_t i = 0; i < table.size(); i++)
+	/*
+	A slot of all zero bits unpacks to an EMPTY_ENTRY, so clearing is just a memset. For big tables we split it into one
+	contiguous chunk per thread, which also spreads the page faults of a freshly allocated table over all the threads.
+	*/
+
+	threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, size / (HUGE_PAGE_SIZE / sizeof(TTBucket)))));
+	size_t chunk = (size + threads - 1) / threads;
+
+	Timer timer;
+	timer.Start();
+
+	std::vector<std::thread> workers;
+
+	for (unsigned int i = 1; i < threads; i++)
 	{
-		table.at(i).Reset();
+		workers.emplace_back([this, i, chunk] { ClearRange(i * chunk, std::min(size, (i + 1) * chunk)); });
 	}
+
+	ClearRange(0, std::min(size, chunk));
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	if (report)
+		std::cout << "info string Hash cleared in " << timer.ElapsedMs() << " ms with " << threads << " threads" << std::endl;
 }
 
-void TranspositionTable::SetSize(uint64_t MB)
+void TranspositionTable::SetSize(uint64_t MB, unsigned int threads, bool report)
 {
 	/*
 	We can't adjust the number of entries based on the size of a mutex because this size is different under msvc (80 bytes) and g++ (8 bytes)
 	*/
 
-	table.clear();
-	size_t EntrySize = sizeof(TTEntry);
+	size_t buckets = (MB * 1024 * 1024 / sizeof(TTBucket));
 
-	size_t entries = (MB * 1024 * 1024 / EntrySize);
-	
-	for (size_t i = 0; i < entries; i++)
-	{
-		table.push_back(TTEntry());
-	}
+	Timer timer;
+	timer.Start();
+
+	Deallocate();
+	Allocate(std::max<size_t>(buckets, 1000 / TTBucketSize));	//GetCapacity samples the first 1000 entries
+	int allocationMs = timer.ElapsedMs();
+
+	ResetTable(threads);
+	int clearMs = timer.ElapsedMs() - allocationMs;
+
+	if (report)
+		std::cout << "info string Hash " << MB << " MB allocated in " << allocationMs << " ms" << (hugePages ? " (huge pages)" : "")
+		<< ", cleared in " << clearMs << " ms with " << threads << " threads" << std::endl;
+}
+
+void TranspositionTable::ClearRange(size_t begin, size_t end)
+{
+	if (begin < end)
+		std::memset(static_cast<void*>(table + begin), 0, (end - begin) * sizeof(TTBucket));
 }
 
 void TranspositionTable::PreFetch(uint64_t key) const
@@ -106,3 +262,216 @@ void TranspositionTable::PreFetch(uint64_t key) const
 	__builtin_prefetch(&table[HashFunction(key)]);
 #endif 
 }
+
+void TranspositionTable::Allocate(size_t buckets)
+{
+	assert(table == nullptr);
+
+	size_t bytes = buckets * sizeof(TTBucket);
+	hugePages = false;
+
+#ifdef _MSC_VER
+	table = static_cast<TTBucket*>(_aligned_malloc(bytes, CACHE_LINE_SIZE));
+#else
+	void* memory = nullptr;
+
+#ifdef __linux__
+	//Ask for transparent huge pages so that the TLB covers far more of the table. If the kernel won't give us them we just carry on with normal pages
+	if (bytes >= HUGE_PAGE_SIZE && posix_memalign(&memory, HUGE_PAGE_SIZE, bytes) == 0)
+		hugePages = (madvise(memory, bytes, MADV_HUGEPAGE) == 0);
+	else
+		memory = nullptr;
+#endif
+
+	if (memory == nullptr && posix_memalign(&memory, CACHE_LINE_SIZE, bytes) != 0)
+		memory = nullptr;
+
+	table = static_cast<TTBucket*>(memory);
+#endif
+
+	if (table == nullptr)
+		throw std::bad_alloc();
+
+	size = buckets;
+}
+
+void TranspositionTable::Deallocate()
+{
+	if (table == nullptr)
+		return;
+
+#ifndef _WIN32
+	if (mapping != nullptr)
+	{
+		munmap(mapping, mappingSize);
+		mapping = nullptr;
+		mappingSize = 0;
+	}
+	else
+#endif
+	{
+#ifdef _MSC_VER
+		_aligned_free(table);
+#else
+		free(table);
+#endif
+	}
+
+	table = nullptr;
+	size = 0;
+	hugePages = false;
+}
+
+bool TranspositionTable::SaveToFile(const std::string& path) const
+{
+	/*
+	The table may be a private mapping of the very file we are saving to. Truncating that file would pull the pages we haven't 
+	written to out from under us, so we write a new file alongside and rename it over the old one. The mapping keeps the old file alive
+	*/
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	TTFileHeader header;
+	std::memcpy(header.magic, TT_FILE_MAGIC, sizeof(header.magic));
+	header.version = TT_FILE_VERSION;
+	header.entryLayout = TTEntryLayout;
+	header.entrySize = sizeof(TTSlot);
+	header.bucketSize = TTBucketSize;
+	header.bucketCount = size;
+	header.hashMB = GetSizeMB();
+	header.networkHash = NetworkHash();
+
+	char padded[TT_FILE_HEADER_SIZE] = {};
+	std::memcpy(padded, &header, sizeof(header));
+
+	file.write(padded, TT_FILE_HEADER_SIZE);
+	file.write(reinterpret_cast<const char*>(table), size * sizeof(TTBucket));
+	file.close();
+
+	if (!file.good())
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	std::remove(path.c_str());		//rename won't replace an existing file on windows. We never map the file there so this is safe
+#endif
+
+	return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool TranspositionTable::LoadFromFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file)
+		return false;
+
+	uint64_t fileSize = file.tellg();
+	TTFileHeader header;
+
+	file.seekg(0);
+	if (fileSize < TT_FILE_HEADER_SIZE || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+
+	if (!IsCompatible(header) || fileSize != TT_FILE_HEADER_SIZE + header.bucketCount * sizeof(TTBucket))
+		return false;
+
+#ifndef _WIN32
+	//A private mapping means the OS pages the table in lazily as the search touches it, and our writes never go back to the file
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	void* map = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return false;
+
+	Deallocate();
+	mapping = map;
+	mappingSize = fileSize;
+	table = reinterpret_cast<TTBucket*>(static_cast<char*>(map) + TT_FILE_HEADER_SIZE);
+	size = header.bucketCount;
+#else
+	Deallocate();
+	Allocate(header.bucketCount);
+
+	file.seekg(TT_FILE_HEADER_SIZE);
+	if (!file.read(reinterpret_cast<char*>(table), size * sizeof(TTBucket)))
+	{
+		ResetTable();
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+bool IsCompatible(const TTFileHeader& header)
+{
+	return std::memcmp(header.magic, TT_FILE_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == TT_FILE_VERSION
+		&& header.entryLayout == TTEntryLayout
+		&& header.entrySize == sizeof(TTSlot)
+		&& header.bucketSize == TTBucketSize
+		&& header.networkHash == NetworkHash()
+		&& header.bucketCount >= 1000 / TTBucketSize;	//GetCapacity samples the first 1000 entries
+}
+
+int ReplacementPriority(const TTEntry& entry, int Turncount, int distanceFromRoot)
+{
+	if (entry.GetCutoff() == EntryType::EMPTY_ENTRY)
+		return INT_MIN;
+
+	return entry.GetDepth() - (entry.IsAncient(Turncount, distanceFromRoot) ? CHAR_MAX : 0);
+}
+
+#ifdef USE_FULL_TT_KEY
+
+void TTSlot::Read(uint64_t& verification, uint64_t& packed) const
+{
+	packed = data.load(std::memory_order_relaxed);
+	verification = keyXorData.load(std::memory_order_relaxed) ^ packed;
+}
+
+void TTSlot::Write(uint64_t verification, uint64_t packed)
+{
+	keyXorData.store(verification ^ packed, std::memory_order_relaxed);
+	data.store(packed, std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t FoldTo16Bits(uint64_t data);
+
+void TTSlot::Read(uint64_t& verification, uint64_t& packed) const
+{
+	packed = 0;
+
+	for (int i = 0; i < 4; i++)
+		packed |= static_cast<uint64_t>(data[i].load(std::memory_order_relaxed)) << (16 * i);
+
+	verification = (keyXorData.load(std::memory_order_relaxed) ^ FoldTo16Bits(packed)) & 0xFFFF;
+}
+
+void TTSlot::Write(uint64_t verification, uint64_t packed)
+{
+	keyXorData.store(static_cast<uint16_t>(verification ^ FoldTo16Bits(packed)), std::memory_order_relaxed);
+
+	for (int i = 0; i < 4; i++)
+		data[i].store(static_cast<uint16_t>(packed >> (16 * i)), std::memory_order_relaxed);
+}
+
+uint64_t FoldTo16Bits(uint64_t data)
+{
+	return (data ^ (data >> 16) ^ (data >> 32) ^ (data >> 48)) & 0xFFFF;
+}
+
+#endif
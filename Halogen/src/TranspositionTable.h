@@ -2,31 +2,104 @@
 #include <vector>
 #include <mutex>
 #include <memory>		//required to compile with g++
+#include <algorithm>
+#include <atomic>
+#include <string>
 #include "TTEntry.h"
 
 const unsigned int mutex_frequency = 1024;					//how many entries per mutex
 
+/*
+The table is shared between all search threads without any locking, and comes in two formats:
+
+The default compact format stores just 16 bits of the key beside the 64 bits of packed data, in five 16 bit words.
+The bucket index comes from the high bits of the key (see HashFunction) so the 16 low bits verify a different part of the key.
+Those 16 bits are stored XOR'd with the data folded down to 16 bits.
+
+Compiling with USE_FULL_TT_KEY stores the whole key in two 64 bit words: the packed data, and the key XOR'd with that data.
+
+Either way, if one thread reads a slot while another is half way through writing it, the words come from different entries
+and the recovered key will not match, so a torn read is just a hash miss.
+*/
+#ifdef USE_FULL_TT_KEY
+
+struct TTSlot
+{
+	static uint64_t VerificationKey(uint64_t key) { return key; }
+
+	void Read(uint64_t& verification, uint64_t& packed) const;
+	void Write(uint64_t verification, uint64_t packed);
+
+	std::atomic<uint64_t> keyXorData;
+	std::atomic<uint64_t> data;
+};
+
+constexpr uint32_t TTEntryLayout = 4;	//bump this whenever the way a TTSlot is packed changes, so that old hash files are rejected
+
+#else
+
+struct TTSlot
+{
+	static uint64_t VerificationKey(uint64_t key) { return key & 0xFFFF; }
+
+	void Read(uint64_t& verification, uint64_t& packed) const;
+	void Write(uint64_t verification, uint64_t packed);
+
+	std::atomic<uint16_t> keyXorData;
+	std::atomic<uint16_t> data[4];
+};
+
+constexpr uint32_t TTEntryLayout = 5;	//bump this whenever the way a TTSlot is packed changes, so that old hash files are rejected
+
+#endif
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t TTBucketSize = CACHE_LINE_SIZE / sizeof(TTSlot);	//6 compact or 4 full entries per bucket
+
+/*
+Each bucket fills exactly one cache line, so that a probe or a store only ever touches a single line of memory.
+*/
+struct alignas(CACHE_LINE_SIZE) TTBucket
+{
+	TTSlot entry[TTBucketSize];
+};
+
+static_assert(sizeof(TTBucket) == CACHE_LINE_SIZE, "TTBucket must be exactly one cache line");
+
 class TranspositionTable
 {
 public:
 	TranspositionTable();
 	~TranspositionTable();
 
-	size_t GetSize() const { return table.size(); }
+	size_t GetSize() const { return size * TTBucketSize; }	//in entries
 	int GetCapacity(int halfmove) const;
 
-	void ResetTable();
-	void SetSize(uint64_t MB);	//will wipe the table and reconstruct a new empty table with a set size. units in MB!
-	void AddEntry(const Move& best, uint64_t ZobristKey, int Score, int Depth, int Turncount, int distanceFromRoot, EntryType Cutoff);
+	void ResetTable(unsigned int threads = 1, bool report = false);				//clears the table in parallel using this many threads. Report prints how long it took
+	void SetSize(uint64_t MB, unsigned int threads = 1, bool report = false);	//will wipe the table and reconstruct a new empty table with a set size. units in MB!
+	void AddEntry(const Move& best, uint64_t ZobristKey, int Score, int StaticEval, int Depth, int Turncount, int distanceFromRoot, EntryType Cutoff);
 	TTEntry GetEntry(uint64_t key);	//you MUST do mate score adjustment if you are using this score in the alpha beta search! for move ordering there is no need
 
 	void SetNonAncient(uint64_t key, int halfmove, int distanceFromRoot);
 
-	uint64_t HashFunction(const uint64_t& key) const;
+	uint64_t HashFunction(const uint64_t& key) const;	//returns the index of the bucket
 	void PreFetch(uint64_t key) const;
 
+	bool SaveToFile(const std::string& path) const;
+	bool LoadFromFile(const std::string& path);			//replaces the table with the one in the file, keeping that files size. Returns false and leaves the table untouched if the file is missing or incompatible
+	uint64_t GetSizeMB() const { return size * sizeof(TTBucket) / (1024 * 1024); }
+
 private:
-	std::vector<TTEntry> table;
+	void Allocate(size_t buckets);
+	void Deallocate();
+	void ClearRange(size_t begin, size_t end);
+
+	TTBucket* table;	//aligned to the cache line size, or to the huge page size where possible
+	size_t size;		//in buckets
+	bool hugePages;		//did the OS accept our request for transparent huge pages?
+
+	void* mapping;		//if the table was loaded from a file it lives inside this memory map rather than an allocation
+	size_t mappingSize;
 };
 
 bool CheckEntry(const TTEntry& entry, uint64_t key, int depth);
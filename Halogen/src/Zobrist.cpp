@@ -1,7 +1,14 @@
 #include "Zobrist.h"
+#include <algorithm>
 
 std::vector<uint64_t> ZobristTable;
 
+uint64_t CuckooKeys[CuckooTableSize];
+Move CuckooMoves[CuckooTableSize];
+
+unsigned int CuckooH1(uint64_t key);		//the two slots a key can go in
+unsigned int CuckooH2(uint64_t key);
+
 void ZobristInit()
 {
 	for (unsigned int i = 0; i < ZobristTableSize; i++)
@@ -9,3 +16,63 @@ void ZobristInit()
 		ZobristTable.push_back(genrand64_int64());
 	}
 }
+
+
+void CuckooInit()
+{
+	for (unsigned int piece = 0; piece < N_PIECES; piece++)
+	{
+		unsigned int pieceType = piece % N_PIECE_TYPES;
+
+		if (pieceType == PAWN)
+			continue;
+
+		for (unsigned int sq1 = 0; sq1 < N_SQUARES; sq1++)
+		{
+			for (unsigned int sq2 = sq1 + 1; sq2 < N_SQUARES; sq2++)
+			{
+				if ((AttackBB(pieceType, sq1, EMPTY) & SquareBB[sq2]) == 0)
+					continue;
+
+				Move move(sq1, sq2, QUIET);
+				uint64_t key = ZobristTable[piece * 64 + sq1] ^ ZobristTable[piece * 64 + sq2] ^ ZobristTable[12 * 64];
+				unsigned int slot = CuckooH1(key);
+
+				while (true)		//keep kicking out whatever is in the slot to its other slot until one is empty
+				{
+					std::swap(CuckooKeys[slot], key);
+					std::swap(CuckooMoves[slot], move);
+
+					if (move.IsUninitialized())
+						break;
+
+					slot = (slot == CuckooH1(key)) ? CuckooH2(key) : CuckooH1(key);
+				}
+			}
+		}
+	}
+}
+
+bool CuckooLookup(uint64_t keyDiff, Move& move)
+{
+	unsigned int slot = CuckooH1(keyDiff);
+
+	if (CuckooKeys[slot] != keyDiff)
+		slot = CuckooH2(keyDiff);
+
+	if (CuckooKeys[slot] != keyDiff)
+		return false;
+
+	move = CuckooMoves[slot];
+	return true;
+}
+
+unsigned int CuckooH1(uint64_t key)
+{
+	return key & (CuckooTableSize - 1);
+}
+
+unsigned int CuckooH2(uint64_t key)
+{
+	return (key >> 16) & (CuckooTableSize - 1);
+}
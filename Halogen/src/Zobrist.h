@@ -1,8 +1,19 @@
 #pragma once
 #include "Random.h"
+#include "BitBoardDefine.h"
+#include "Move.h"
 #include <stdint.h>
 #include <vector>
 
 const unsigned int ZobristTableSize = 12 * 64 + 1 + 4 + 8;	//12 pieces * 64 squares, 1 for side to move, 4 for casteling rights and 8 for ep. square
 extern std::vector<uint64_t> ZobristTable;
-void ZobristInit();
\ No newline at end of file
+void ZobristInit();
+
+/*
+Every reversible move of a knight, bishop, rook, queen or king has a key difference it makes to the zobrist key (the two squares and the side to move).
+These are stored in a cuckoo hash table so we can look up if the difference between two keys is one move in constant time.
+Used to see if the side to move can go back to a position we have had before. Call CuckooInit() after ZobristInit() and BBInit().
+*/
+const unsigned int CuckooTableSize = 8192;
+void CuckooInit();
+bool CuckooLookup(uint64_t keyDiff, Move& move);		//is keyDiff the difference one move makes to the key, and if so which move (from the lower square to the higher)
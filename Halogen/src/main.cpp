@@ -1,6 +1,9 @@
 #include "Benchmark.h"
 #include "Search.h"
+#include "AllocationCounter.h"
 #include <thread>
+#include <random>
+#include <chrono>
 
 using namespace::std; 
 
@@ -9,6 +12,10 @@ void PrintVersion();
 uint64_t PerftDivide(unsigned int depth, Position& position);
 uint64_t Perft(unsigned int depth, Position& position);
 void Bench();
+void TTStressTest(unsigned int threads, int seconds);
+void EvalBench(int iterations);
+void NetCheck();
+bool ScoreFile(const string& inputPath, const string& outputPath, unsigned int threads);
 
 string version = "8.1";  
 
@@ -26,6 +33,7 @@ int main(int argc, char* argv[])
 
 	ZobristInit();
 	BBInit();
+	CuckooInit();
 
 	string Line;					//to read the command given by the GUI
 	cout.setf(ios::unitbuf);		// Make sure that the outputs are sent straight away to the GUI
@@ -35,9 +43,40 @@ int main(int argc, char* argv[])
 
 	tTable.SetSize(1);
 
+	//Halogen convertnet <text network> <binary network> [include file]. Comes before loading the embedded network, so that a mismatched one can be replaced
+	if (argc >= 4 && strcmp(argv[1], "convertnet") == 0) { return ConvertNetwork(argv[2], argv[3], argc >= 5 ? argv[4] : "") ? 0 : 1; }
+
+	if (!LoadDefaultNetwork())
+	{
+		cout << "info string the embedded network does not match the compiled architecture" << endl;
+		return 1;
+	}
+
+	//Halogen scorefile <fen or epd file> <output epd file> [threads]
+	if (argc >= 4 && strcmp(argv[1], "scorefile") == 0) { return ScoreFile(argv[2], argv[3], argc >= 5 ? stoi(argv[4]) : 1) ? 0 : 1; }
+
 	Position position;
+	string positionBase;			//the start of the last position command, "startpos" or the fen
+	vector<string> positionMoves;	//and the moves that have been played from it
 
 	unsigned int ThreadCount = 1;
+	string HashFile = "<empty>";
+	bool hashFilePending = false;	//HashFile still has to be loaded, which happens at the next isready or go (see the HashFile option below)
+	bool hashFromFile = false;		//the table was loaded from HashFile, so ucinewgame keeps it
+
+	auto ApplyHashFile = [&]()
+	{
+		if (!hashFilePending)
+			return;
+
+		hashFilePending = false;
+
+		if (tTable.LoadFromFile(HashFile))
+		{
+			hashFromFile = true;
+			cout << "info string loaded " << tTable.GetSizeMB() << " MB hash from " << HashFile << endl;
+		}
+	};
 
 	if (argc == 2 && strcmp(argv[1], "bench") == 0) { Bench(); return 0; }	//currently only supports bench from command line for openBench integration
 
@@ -56,46 +95,81 @@ int main(int argc, char* argv[])
 			cout << "option name Hash type spin default 2 min 2 max 262144" << endl;
 			cout << "option name Threads type spin default 1 min 1 max 64" << endl;
 			cout << "option name SyzygyPath type string default <empty>" << endl;
+			cout << "option name HashFile type string default <empty>" << endl;
+			cout << "option name Save Hash type button" << endl;
+			cout << "option name EvalFile type string default <empty>" << endl;
+			cout << "option name EvalCache type spin default 1 min 1 max 4096" << endl;
+			cout << "option name EvalCacheStats type check default false" << endl;
 			cout << "uciok" << endl;
 		}
 
-		else if (token == "isready") cout << "readyok" << endl;
+		else if (token == "isready")
+		{
+			ApplyHashFile();
+			cout << "readyok" << endl;
+		}
 
 		else if (token == "ucinewgame")
 		{
 			position.StartingPosition();
-			tTable.ResetTable();
+			positionBase.clear();
+			positionMoves.clear();
+
+			if (!hashFromFile)
+				tTable.ResetTable(ThreadCount, true);
 		}
 
 		else if (token == "position")
 		{
-			position.Reset();
-			position.StartingPosition();
+			string base;
+			vector<string> fen;
+			vector<string> moves;
 
 			iss >> token;
+			bool fromFen = token == "fen";
 
 			if (token == "fen")
 			{
-				vector<string> fen;
-
 				while (iss >> token && token != "moves")
 				{
 					fen.push_back(token);
+					base += " " + token;
 				}
-
-				if (!position.InitialiseFromFen(fen)) cout << "BAD FEN" << endl;
-				if (token == "moves") while (iss >> token) position.ApplyMove(token);
 			}
 
 			if (token == "startpos")
 			{
+				base = token;
 				iss >> token;
-				if (token == "moves") while (iss >> token) position.ApplyMove(token);
 			}
+
+			if (token == "moves") while (iss >> token) moves.push_back(token);
+
+			//GUIs send the whole game every move, so if this carries on from the last position we only need to play the new moves
+			bool extendsPrevious = !base.empty() && base == positionBase && moves.size() >= positionMoves.size() && equal(positionMoves.begin(), positionMoves.end(), moves.begin());
+
+			if (!extendsPrevious)
+			{
+				position.Reset();
+				position.StartingPosition();
+				positionMoves.clear();
+
+				if (fromFen && !position.InitialiseFromFen(fen))
+				{
+					cout << "BAD FEN" << endl;
+					base.clear();
+				}
+			}
+
+			position.ApplyMoves(vector<string>(moves.begin() + positionMoves.size(), moves.end()));
+			positionBase = base;
+			positionMoves = moves;
 		}
 
 		else if (token == "go")
 		{
+			ApplyHashFile();
+
 			int wtime = 0;
 			int btime = 0;
 			int winc = 0;
@@ -149,7 +223,9 @@ int main(int argc, char* argv[])
 				iss >> token;
 				if (token == "Hash") 
 				{
-					tTable.ResetTable();
+					tTable.ResetTable(ThreadCount, true);
+					hashFilePending = false;
+					hashFromFile = false;
 				}
 			}
 
@@ -157,7 +233,47 @@ int main(int argc, char* argv[])
 			{
 				iss >> token; //'value'
 				iss >> token;
-				tTable.SetSize(stoi(token));
+				tTable.SetSize(stoi(token), ThreadCount, true);
+				hashFilePending = HashFile != "<empty>";		//a HashFile wins over Hash, the table takes the size of the file
+				hashFromFile = false;
+			}
+
+			else if (token == "EvalFile")
+			{
+				iss >> token; //'value'
+				string EvalFile;
+				getline(iss >> ws, EvalFile);	//allow spaces in the path
+
+				if (EvalFile == "<empty>")
+					LoadDefaultNetwork();
+				else if (LoadNetwork(EvalFile))
+					cout << "info string loaded network " << EvalFile << endl;
+				else
+				{
+					cout << "info string could not load a compatible network from " << EvalFile << endl;
+					continue;
+				}
+
+				//cached evaluations, including the static evals in the hash table, came from the old network
+				position.ReloadNetwork();
+				evalCache.Reset();
+				tTable.ResetTable(ThreadCount);
+				hashFilePending = HashFile != "<empty>";		//the file is only used if it was saved with this network
+				hashFromFile = false;
+			}
+
+			else if (token == "EvalCache")
+			{
+				iss >> token; //'value'
+				iss >> token;
+				evalCache.SetSize(stoi(token));
+			}
+
+			else if (token == "EvalCacheStats")
+			{
+				iss >> token; //'value'
+				iss >> token;
+				ReportEvalCacheStats = (token == "true");
 			}
 
 			else if (token == "Threads")
@@ -167,6 +283,35 @@ int main(int argc, char* argv[])
 				ThreadCount = stoi(token);
 			}
 
+			else if (token == "Save")
+			{
+				iss >> token;
+				if (token == "Hash")
+				{
+					ApplyHashFile();		//don't overwrite the file before we have read it
+
+					if (HashFile == "<empty>")
+						cout << "info string no HashFile set" << endl;
+					else if (tTable.SaveToFile(HashFile))
+						cout << "info string saved " << tTable.GetSizeMB() << " MB hash to " << HashFile << endl;
+					else
+						cout << "info string could not write hash to " << HashFile << endl;
+				}
+			}
+
+			else if (token == "HashFile")
+			{
+				iss >> token; //'value'
+				getline(iss >> ws, HashFile);	//allow spaces in the path
+
+				/*
+				If there is already a compatible file here we resume from it, otherwise this is just where 'Save Hash' will write to.
+				GUIs send ucinewgame and often Hash after the other options, so the file is only loaded at the next isready or go.
+				A loaded table takes the size of the file even if Hash is set afterwards, and is kept through ucinewgame.
+				*/
+				hashFilePending = HashFile != "<empty>";
+			}
+
 			else if (token == "SyzygyPath")
 			{
 				iss >> token; //'value'
@@ -187,6 +332,26 @@ int main(int argc, char* argv[])
 		else if (token == "print") position.Print();
 		else if (token == "quit") return 0;
 		else if (token == "bench") Bench();
+
+		else if (token == "evalbench")
+		{
+			int iterations = 1000000;
+			if (iss >> token) iterations = stoi(token);
+			EvalBench(iterations);
+		}
+
+		else if (token == "netcheck") NetCheck();
+
+		else if (token == "ttstress")
+		{
+			unsigned int threads = ThreadCount;
+			int seconds = 5;
+
+			if (iss >> token) threads = stoi(token);
+			if (iss >> token) seconds = stoi(token);
+
+			TTStressTest(threads, seconds);
+		}
 		
 		else cout << "Unknown command" << endl;
 	}
@@ -310,7 +475,7 @@ uint64_t PerftDivide(unsigned int depth, Position& position)
 	clock_t before = clock();
 
 	uint64_t nodeCount = 0;
-	vector<Move> moves;
+	MoveList moves;
 	LegalMoves(position, moves);
 
 	for (size_t i = 0; i < moves.size(); i++)
@@ -338,7 +503,7 @@ uint64_t Perft(unsigned int depth, Position& position)
 		return 1;	//if perftdivide is called with 1 this is necesary
 
 	uint64_t nodeCount = 0;
-	vector<Move> moves;
+	MoveList moves;
 	LegalMoves(position, moves);
 
 	if (depth == 1)
@@ -360,6 +525,7 @@ void Bench()
 	timer.Start();
 
 	uint64_t nodeCount = 0;
+	uint64_t allocations = 0;
 	Position position;
 
 	for (size_t i = 0; i < benchMarkPositions.size(); i++)
@@ -370,9 +536,321 @@ void Bench()
 			break;
 		}
 
+		uint64_t before = AllocationCount();
 		uint64_t nodes = BenchSearch(position, 12);
+		allocations += AllocationCount() - before;
 		nodeCount += nodes;
 	}
 
+#ifndef NDEBUG
+	cout << allocations << " heap allocations during the searches" << endl;		//the setup of each search allocates, but the nodes themselves should not
+#endif
+
 	cout << nodeCount << " nodes " << int(nodeCount / max(timer.ElapsedMs(), 1) * 1000) << " nps" << endl;
 }
+
+void EvalBench(int iterations)
+{
+	/*
+	Times the network on its own, away from move generation and the search: a full refresh of the hidden layer, 
+	an incremental update of a quiet move followed by an evaluation and undo, and the evaluation from the hidden layer onwards
+	*/
+
+	Position position;
+	std::mt19937_64 gen(0);
+	int64_t sink = 0;
+	Network* volatile net = &position.net;	//reloading the pointer each time stops the compiler hoisting the work out of the loops
+
+	std::array<int16_t, INPUT_NEURONS> inputs = {};
+	for (int i = 0; i < 32; i++)
+		inputs[gen() % INPUT_NEURONS] = PRECISION;
+
+	deltaArray delta;
+	delta.size = 2;
+	delta.deltas[0] = { static_cast<size_t>(gen() % INPUT_NEURONS), -1 };
+	delta.deltas[1] = { static_cast<size_t>(gen() % INPUT_NEURONS), 1 };
+
+	int refreshes = std::max(1, iterations / 100);	//a refresh is about 100 times the work of the others
+	auto nsSince = [](std::chrono::steady_clock::time_point start) { return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(); };
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < refreshes; i++)
+	{
+		net->RecalculateIncremental(inputs);
+		sink += net->QuickEval();
+	}
+	double refreshNs = nsSince(start) / refreshes;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		net->ApplyDelta(delta);
+		sink += net->QuickEval();	//updates are only applied when something is evaluated
+		net->ApplyInverseDelta();
+	}
+	double updateNs = nsSince(start) / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		sink += net->QuickEval();
+	}
+	double evalNs = nsSince(start) / iterations;
+
+	cout << "kernels " << NETWORK_KERNELS
+		<< " refresh " << refreshNs << " ns"
+		<< " update+eval " << updateNs << " ns"
+		<< " eval " << evalNs << " ns"
+		<< " (checksum " << sink << ")" << endl;
+}
+
+void NetCheck()
+{
+	/*
+	Compare the int8 hidden -> output path against the int16 one it approximates, on each of the bench positions 
+	and every position one legal move away from them. Both read the same accumulator so only the later layers are being tested
+	*/
+
+	Position position;
+	uint64_t count = 0;
+	int64_t totalError = 0;
+	int maxError = 0;
+	size_t worst = 0;
+	size_t current = 0;
+
+	auto check = [&]()
+	{
+		int error = abs(position.net.QuickEvalInt8() - position.net.QuickEvalInt16());
+
+		count++;
+		totalError += error;
+
+		if (error > maxError)
+		{
+			maxError = error;
+			worst = current;
+		}
+	};
+
+	for (current = 0; current < benchMarkPositions.size(); current++)
+	{
+		if (!position.InitialiseFromFen(benchMarkPositions[current]))
+		{
+			cout << "BAD FEN!" << endl;
+			break;
+		}
+
+		check();
+
+		MoveList moves;
+		LegalMoves(position, moves);
+
+		for (size_t j = 0; j < moves.size(); j++)
+		{
+			position.ApplyMove(moves[j]);
+			check();
+			position.RevertMove();
+		}
+	}
+
+	cout << "kernels " << NETWORK_KERNELS
+		<< " positions " << count
+		<< " mean error " << static_cast<double>(totalError) / std::max<uint64_t>(count, 1)
+		<< " max error " << maxError;
+
+	if (maxError > 0)
+		cout << " (near bench position " << worst + 1 << ")";
+
+	cout << endl;
+}
+
+bool ScoreFile(const string& inputPath, const string& outputPath, unsigned int threads)
+{
+	/*
+	Score every position in a file of FENs or EPDs with the network alone, for labelling datasets. The output has the first four fields 
+	of each line followed by a 'ce' opcode with the score in centipawns from the side to moves point of view. Lines that can't be read,
+	or that have more than 32 pieces, don't have one king each or have the side not to move in check, are copied across unchanged. The positions are handed out to the threads in chunks and each chunk is evaluated with EvaluateBatch
+	*/
+
+	ifstream input(inputPath);
+	ofstream output(outputPath);
+
+	if (!input || !output)
+	{
+		cout << "info string could not open " << (!input ? inputPath : outputPath) << endl;
+		return false;
+	}
+
+	vector<string> lines;
+	string line;
+
+	while (getline(input, line))
+		lines.push_back(line);
+
+	const size_t chunkSize = 16 * NETWORK_BATCH_SIZE;
+	vector<vector<string>> fields(lines.size());
+	vector<int16_t> scores(lines.size());
+	vector<char> valid(lines.size());
+	atomic<size_t> nextChunk(0);
+
+	auto worker = [&]()
+	{
+		Position position;
+		vector<NetworkInput> inputs;
+		vector<size_t> indexes;
+		vector<int16_t> results;
+
+		for (size_t start = nextChunk.fetch_add(chunkSize); start < lines.size(); start = nextChunk.fetch_add(chunkSize))
+		{
+			size_t end = std::min(lines.size(), start + chunkSize);
+
+			inputs.clear();
+			indexes.clear();
+
+			for (size_t i = start; i < end; i++)
+			{
+				istringstream iss(lines[i]);
+				string token;
+
+				while (fields[i].size() < 4 && iss >> token)
+					fields[i].push_back(token);
+
+				valid[i] = fields[i].size() == 4 && (fields[i][1] == "w" || fields[i][1] == "b") && position.InitialiseBoardFromFen(fields[i]);
+
+				//a fen can parse and still not be a position the network could ever have seen
+				if (valid[i])
+				{
+					Players notToMove = fields[i][1] == "w" ? BLACK : WHITE;
+
+					valid[i] = GetBitCount(position.GetAllPieces()) <= MAX_ACTIVE_INPUTS
+						&& GetBitCount(position.GetPieceBB(KING, WHITE)) == 1
+						&& GetBitCount(position.GetPieceBB(KING, BLACK)) == 1
+						&& !IsSquareThreatened(position, position.GetKing(notToMove), notToMove);
+
+					for (unsigned int piece = 0; piece < N_PIECES; piece++)
+					{
+						if (GetBitCount(position.GetPieceBB(piece)) > 15)		//the material key only has 4 bits for each piece
+							valid[i] = false;
+					}
+				}
+
+				if (valid[i])
+				{
+					inputs.push_back(position.GetNetworkInput());
+					indexes.push_back(i);
+				}
+			}
+
+			results.resize(inputs.size());
+			EvaluateBatch(inputs.data(), results.data(), inputs.size());
+
+			for (size_t i = 0; i < indexes.size(); i++)
+				scores[indexes[i]] = fields[indexes[i]][1] == "w" ? results[i] : -results[i];
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	vector<thread> pool;
+	for (unsigned int i = 0; i < std::max(1u, threads); i++)
+		pool.push_back(thread(worker));
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t scored = 0;
+
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		if (valid[i])
+		{
+			output << fields[i][0] << " " << fields[i][1] << " " << fields[i][2] << " " << fields[i][3] << " ce " << scores[i] << ";\n";
+			scored++;
+		}
+		else
+			output << lines[i] << "\n";
+	}
+
+	cout << "scored " << scored << " of " << lines.size() << " positions with " << pool.size() << " threads in " << seconds << " s"
+		<< " (" << static_cast<uint64_t>(scored / std::max(seconds, 1e-9)) << " positions per second)" << endl;
+
+	return true;
+}
+
+void TTStressTest(unsigned int threads, int seconds)
+{
+	/*
+	Hammer a small table from many threads at once. Every key always gets stored with the same data (derived from the key itself) 
+	so if a probe ever returns an entry that passes the key check but carries different data, then it was torn between two writes
+	*/
+
+	TranspositionTable table;
+	table.SetSize(1);	//small table so that the threads are constantly fighting over the same buckets
+
+	const uint64_t keyCount = 1 << 20;	//many more keys than slots so entries are constantly being replaced
+	std::atomic<uint64_t> probes(0);
+	std::atomic<uint64_t> hits(0);
+	std::atomic<uint64_t> torn(0);
+	std::atomic<bool> running(true);
+
+	//the data only depends on the low 16 bits, so that two keys which the compact table can't tell apart still agree on their data
+	auto expectedMove = [](uint64_t key) { return static_cast<unsigned short>(((key & 0xFFFF) * 0x9E3779B97F4A7C15ULL) >> 48); };
+	auto expectedScore = [](uint64_t key) { return static_cast<int>((key & 0xFFFF) % 8000) - 4000; };
+	auto expectedDepth = [](uint64_t key) { return static_cast<int>((key & 0xFFFF) % 64); };
+
+	std::vector<std::thread> workers;
+
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		workers.emplace_back([&, i]
+		{
+			std::mt19937_64 gen(i);
+			uint64_t localProbes = 0;
+			uint64_t localHits = 0;
+			uint64_t localTorn = 0;
+
+			while (running)
+			{
+				uint64_t key = gen() % keyCount;
+				key = key * 0x9E3779B97F4A7C15ULL ^ (key << 32);	//spread the keys over the whole table
+
+				if (gen() & 1)
+				{
+					table.AddEntry(Move(expectedMove(key)), key, expectedScore(key), -expectedScore(key), expectedDepth(key), 0, 0, EntryType::EXACT);
+				}
+				else
+				{
+					TTEntry entry = table.GetEntry(key);
+					localProbes++;
+
+					if (CheckEntry(entry, key))
+					{
+						localHits++;
+
+						if (entry.GetMove().GetBits() != expectedMove(key) || entry.GetScore() != expectedScore(key) || entry.GetStaticEval() != -expectedScore(key) || entry.GetDepth() != expectedDepth(key))
+							localTorn++;
+					}
+				}
+			}
+
+			probes += localProbes;
+			hits += localHits;
+			torn += localTorn;
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	running = false;
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	cout << "threads " << threads 
+		<< " probes " << probes 
+		<< " hits " << hits 
+		<< " torn " << torn 
+		<< " torn rate " << static_cast<double>(torn) / std::max<uint64_t>(hits, 1) << endl;
+}